@@ -0,0 +1,28 @@
+/*
+ * aes - AES-128 decryption primitives
+ *
+ * Just enough AES for XEX image decryption: one-block ECB decryption
+ * for the session key unwrap and CBC decryption for the image payload.
+ * Uses AES-NI instructions when the CPU has them, with a portable
+ * software fallback.
+ */
+
+#ifndef XEXTOOL_AES_H
+#define XEXTOOL_AES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Decrypt a single 16-byte block in ECB mode */
+void aes128_decrypt_ecb(const uint8_t key[16], const uint8_t in[16],
+                        uint8_t out[16]);
+
+/*
+ * Decrypt len bytes in CBC mode.  len is rounded down to a multiple of
+ * 16; any trailing partial block is copied through unchanged.  in and
+ * out may not overlap.
+ */
+void aes128_decrypt_cbc(const uint8_t key[16], const uint8_t iv[16],
+                        const uint8_t *in, uint8_t *out, size_t len);
+
+#endif /* XEXTOOL_AES_H */
@@ -0,0 +1,305 @@
+/*
+ * bench - throughput benchmark harness for the parsing core
+ *
+ * Runs the libxextool parse path over a real image (when given one)
+ * and a set of synthetically generated XEX files with varying optional
+ * header counts and file sizes, reporting files/sec, MB/sec and a
+ * per-stage breakdown (open/parse/close) across repeated iterations
+ * with warmup.  Built and run via `make bench`.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "xex.h"
+
+#define BENCH_WARMUP_ITERATIONS 50
+#define BENCH_ITERATIONS        2000
+
+/* Fixed first block of the parse arena; it grows for larger tables */
+#define PARSE_ARENA_SIZE 1024
+
+/* Monotonic clock in nanoseconds */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Write a synthetic XEX image with the given header count and body size */
+static int write_synthetic_xex(const char *path, uint32_t opt_count,
+                               size_t body_size) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return 1;
+    }
+
+    size_t header_bytes = sizeof(XEX2_Header) +
+                          (size_t)opt_count * sizeof(XexOptHeader);
+    uint32_t ffi_offset = (uint32_t)header_bytes;
+    uint32_t pe_offset = (uint32_t)(header_bytes + sizeof(FileFormatInfo));
+
+    XEX2_Header header;
+    header.magic = be32_to_cpu(XEX2_MAGIC);
+    header.module_flags = be32_to_cpu(1);
+    header.pe_offset = be32_to_cpu(pe_offset);
+    header.reserved = 0;
+    header.security_offset = be32_to_cpu(0);
+    header.optional_header_count = be32_to_cpu(opt_count);
+
+    int ok = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header);
+
+    /* Filler keys, with FILE_FORMAT_INFO as the last entry */
+    for (uint32_t i = 0; ok && i < opt_count; i++) {
+        XexOptHeader opt;
+        if (i == opt_count - 1) {
+            opt.key = be32_to_cpu(XEX_HEADER_FILE_FORMAT_INFO);
+            opt.value = be32_to_cpu(ffi_offset);
+        } else {
+            opt.key = be32_to_cpu(0x00018002 + i);
+            opt.value = be32_to_cpu(i);
+        }
+        ok = write(fd, &opt, sizeof(opt)) == (ssize_t)sizeof(opt);
+    }
+
+    if (ok) {
+        FileFormatInfo ffi;
+        ffi.info_size = be32_to_cpu(sizeof(FileFormatInfo));
+        ffi.encryption_type = be16_to_cpu(XEX_ENCRYPTION_NONE);
+        ffi.compression_type = be16_to_cpu(XEX_COMPRESSION_NONE);
+        ok = write(fd, &ffi, sizeof(ffi)) == (ssize_t)sizeof(ffi);
+    }
+
+    /* Body padding up to the requested file size */
+    if (ok && body_size > 0) {
+        static const uint8_t padding[65536];
+        size_t remaining = body_size;
+        while (ok && remaining > 0) {
+            size_t n = remaining < sizeof(padding) ? remaining : sizeof(padding);
+            ok = write(fd, padding, n) == (ssize_t)n;
+            remaining -= n;
+        }
+    }
+
+    close(fd);
+    return ok ? 0 : 1;
+}
+
+/* Benchmark one file: repeated open/parse/close with a warmup phase */
+static void bench_file(const char *label, const char *path) {
+    uint64_t open_ns = 0, parse_ns = 0, close_ns = 0;
+    size_t file_size = 0;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+
+    for (int iter = -BENCH_WARMUP_ITERATIONS; iter < BENCH_ITERATIONS; iter++) {
+        XexView view;
+        XexArena arena;
+        XexParsed parsed;
+
+        uint64_t t0 = now_ns();
+        if (xex_view_open(path, &view, 1) != XEX_OK) {
+            fprintf(stderr, "ERROR: Cannot open '%s'\n", path);
+            return;
+        }
+        uint64_t t1 = now_ns();
+
+        xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+        int status = xex_parse(&view, &arena, &parsed);
+        uint64_t t2 = now_ns();
+
+        file_size = view.size;
+        xex_view_close(&view);
+        xex_arena_release(&arena);
+        uint64_t t3 = now_ns();
+
+        if (status != XEX_OK) {
+            fprintf(stderr, "ERROR: Cannot parse '%s': %s\n",
+                    path, xex_strerror(status));
+            return;
+        }
+
+        if (iter >= 0) {    /* Warmup iterations are discarded */
+            open_ns += t1 - t0;
+            parse_ns += t2 - t1;
+            close_ns += t3 - t2;
+        }
+    }
+
+    uint64_t total_ns = open_ns + parse_ns + close_ns;
+    double seconds = (double)total_ns / 1e9;
+    double files_per_sec = BENCH_ITERATIONS / seconds;
+    double mb_per_sec = ((double)file_size * BENCH_ITERATIONS) /
+                        (1024.0 * 1024.0) / seconds;
+
+    printf("%-24s %10.0f files/s %9.1f MB/s  "
+           "open %5.2fus parse %5.2fus close %5.2fus\n",
+           label, files_per_sec, mb_per_sec,
+           (double)open_ns / BENCH_ITERATIONS / 1000.0,
+           (double)parse_ns / BENCH_ITERATIONS / 1000.0,
+           (double)close_ns / BENCH_ITERATIONS / 1000.0);
+}
+
+/*
+ * Scan scaling curve: the corpus aggregation design from --scan (atomic
+ * work claiming, per-thread result buffers and sharded counters) run at
+ * 1..32 threads over the same file list, to show the aggregation itself
+ * adds no cross-thread contention.
+ */
+
+#define SCALE_CORPUS_FILES 512
+#define SCALE_PASSES       8
+
+/* Per-thread shard: private counters and report buffer */
+typedef struct {
+    size_t analyzed;
+    size_t invalid;
+    char line_buf[128];
+    size_t lines;
+} ScaleWorker;
+
+static char **scale_paths;
+static size_t scale_count;
+static size_t scale_next;  /* Claimed with an atomic increment */
+
+static void *scale_worker(void *arg) {
+    ScaleWorker *w = arg;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+
+    for (;;) {
+        size_t index = __atomic_fetch_add(&scale_next, 1, __ATOMIC_RELAXED);
+        if (index >= scale_count) {
+            break;
+        }
+
+        XexView view;
+        XexArena arena;
+        XexParsed parsed;
+        if (xex_view_open(scale_paths[index], &view, 1) != XEX_OK) {
+            w->invalid++;
+            continue;
+        }
+        xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+        if (xex_parse(&view, &arena, &parsed) == XEX_OK) {
+            w->analyzed++;
+            /* Format the report line into the private buffer, as the
+             * scan workers do, so formatting cost is included */
+            w->lines += (size_t)snprintf(w->line_buf, sizeof(w->line_buf),
+                                         "%s: headers=%u\n",
+                                         scale_paths[index], parsed.opt_count);
+        } else {
+            w->invalid++;
+        }
+        xex_arena_release(&arena);
+        xex_view_close(&view);
+    }
+    return NULL;
+}
+
+static void bench_scan_scaling(const char *dir) {
+    char *paths[SCALE_CORPUS_FILES];
+    for (size_t i = 0; i < SCALE_CORPUS_FILES; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/scale%zu.xex", dir, i);
+        if (write_synthetic_xex(path, 25, 4096) != 0) {
+            fprintf(stderr, "ERROR: Cannot write scaling corpus\n");
+            return;
+        }
+        paths[i] = strdup(path);
+    }
+    scale_paths = paths;
+    scale_count = SCALE_CORPUS_FILES;
+
+    printf("\n=== scan scaling (%u files x %u passes) ===\n",
+           SCALE_CORPUS_FILES, SCALE_PASSES);
+
+    static const int thread_counts[] = { 1, 2, 4, 8, 16, 32 };
+    double base_rate = 0.0;
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+        int nthreads = thread_counts[t];
+        ScaleWorker workers[32];
+        pthread_t threads[32];
+
+        uint64_t t0 = now_ns();
+        for (int pass = 0; pass < SCALE_PASSES; pass++) {
+            memset(workers, 0, sizeof(workers));
+            scale_next = 0;
+            for (int i = 0; i < nthreads; i++) {
+                pthread_create(&threads[i], NULL, scale_worker, &workers[i]);
+            }
+            for (int i = 0; i < nthreads; i++) {
+                pthread_join(threads[i], NULL);
+            }
+        }
+        uint64_t elapsed = now_ns() - t0;
+
+        size_t analyzed = 0;
+        for (int i = 0; i < nthreads; i++) {
+            analyzed += workers[i].analyzed;
+        }
+        double rate = (double)(SCALE_CORPUS_FILES * SCALE_PASSES) /
+                      ((double)elapsed / 1e9);
+        if (t == 0) {
+            base_rate = rate;
+        }
+        printf("threads %2d: %10.0f files/s  %5.2fx  (analyzed %zu/pass)\n",
+               nthreads, rate, rate / base_rate, analyzed);
+    }
+
+    for (size_t i = 0; i < SCALE_CORPUS_FILES; i++) {
+        unlink(paths[i]);
+        free(paths[i]);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    printf("=== xextool parse benchmark ===\n");
+    printf("%d iterations per case, %d warmup\n\n",
+           BENCH_ITERATIONS, BENCH_WARMUP_ITERATIONS);
+
+    /* Real image, when provided */
+    if (argc > 1) {
+        bench_file("real image", argv[1]);
+    }
+
+    /* Synthetic images: header count and file size sweeps */
+    char dir[] = "/tmp/xextool-bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "ERROR: Cannot create temporary directory\n");
+        return 1;
+    }
+
+    /* The largest case overflows the fixed arena block on purpose */
+    static const uint32_t header_counts[] = { 5, 25, 500 };
+    static const size_t body_sizes[] = { 4096, 262144, 4 * 1024 * 1024 };
+
+    for (size_t h = 0; h < sizeof(header_counts) / sizeof(header_counts[0]); h++) {
+        for (size_t s = 0; s < sizeof(body_sizes) / sizeof(body_sizes[0]); s++) {
+            char path[4096];
+            char label[64];
+            snprintf(path, sizeof(path), "%s/h%u_s%zu.xex",
+                     dir, header_counts[h], body_sizes[s]);
+            snprintf(label, sizeof(label), "%u hdrs, %zu KB",
+                     header_counts[h], body_sizes[s] / 1024);
+
+            if (write_synthetic_xex(path, header_counts[h], body_sizes[s]) != 0) {
+                fprintf(stderr, "ERROR: Cannot write '%s'\n", path);
+                continue;
+            }
+            bench_file(label, path);
+            unlink(path);
+        }
+    }
+
+    bench_scan_scaling(dir);
+
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,444 @@
+/*
+ * bench_micro - kernel-level microbenchmarks for the hot primitives
+ *
+ * Where bench.c measures whole-file throughput, this harness times the
+ * individual kernels underneath it: scalar vs. bulk byte-order
+ * conversion, optional-header key dispatch, the analysis cache hit
+ * path, and the import hash-lookup APIs.  Each kernel runs a fixed
+ * iteration count after a warmup phase and is timed with the cycle
+ * counter (rdtsc on x86, falling back to the monotonic clock), so a
+ * regression in any one kernel shows up directly instead of being
+ * averaged into file throughput.
+ *
+ * Besides the human-readable table on stdout, every kernel appends one
+ * NDJSON record to bench-micro-results.json in the working directory;
+ * diffing that file between two commits pinpoints which kernel moved.
+ * Built and run via `make bench-micro`.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+#include "xex.h"
+#include "cache.h"
+
+#define MICRO_WARMUP_ITERATIONS 1000
+#define MICRO_RESULTS_FILE "bench-micro-results.json"
+
+/* Arena for import table parsing, matching the CLI's sizing */
+#define MICRO_IMPORT_ARENA_SIZE (256 * 1024)
+
+/* Monotonic clock in nanoseconds */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Cycle counter; zero when the target has no cheap one */
+#if defined(__x86_64__) || defined(__i386__)
+#define MICRO_HAVE_CYCLES 1
+static uint64_t cycles_now(void) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+#else
+#define MICRO_HAVE_CYCLES 0
+static uint64_t cycles_now(void) {
+    return 0;
+}
+#endif
+
+/* Sink the compiler cannot see through, so kernels are not elided */
+static volatile uint64_t micro_sink;
+
+static FILE *results_file;
+
+/* Report one kernel: a table row on stdout, an NDJSON record on disk */
+static void micro_report(const char *kernel, uint64_t iterations,
+                         uint64_t ops_per_iter, uint64_t ns, uint64_t cycles) {
+    double ops = (double)iterations * (double)ops_per_iter;
+    double ns_per_op = (double)ns / ops;
+
+    printf("%-24s %12.3f ns/op", kernel, ns_per_op);
+    if (MICRO_HAVE_CYCLES) {
+        printf(" %10.2f cycles/op", (double)cycles / ops);
+    }
+    printf("  (%llu x %llu ops)\n",
+           (unsigned long long)iterations, (unsigned long long)ops_per_iter);
+
+    if (results_file) {
+        fprintf(results_file,
+                "{\"kernel\":\"%s\",\"iterations\":%llu,\"ops_per_iter\":%llu"
+                ",\"ns_per_op\":%.4f",
+                kernel, (unsigned long long)iterations,
+                (unsigned long long)ops_per_iter, ns_per_op);
+        if (MICRO_HAVE_CYCLES) {
+            fprintf(results_file, ",\"cycles_per_op\":%.4f",
+                    (double)cycles / ops);
+        }
+        fprintf(results_file, "}\n");
+    }
+}
+
+/*
+ * ---- Byte-order conversion kernels ----
+ *
+ * One 4096-dword buffer, converted either through a per-element call
+ * or through the vectorized be32_to_cpu_array bulk path.  The buffer
+ * is re-randomized once up front; each iteration converts in place,
+ * which is self-inverse for byte swapping.
+ */
+
+#define MICRO_CONVERT_DWORDS 4096
+#define MICRO_CONVERT_ITERS  50000
+
+static void bench_be32_scalar(uint32_t *buf) {
+    uint64_t t0 = 0, c0 = 0;
+    for (int iter = -MICRO_WARMUP_ITERATIONS; iter < MICRO_CONVERT_ITERS;
+         iter++) {
+        if (iter == 0) {
+            t0 = now_ns();
+            c0 = cycles_now();
+        }
+        uint64_t acc = 0;
+        for (size_t i = 0; i < MICRO_CONVERT_DWORDS; i++) {
+            buf[i] = be32_to_cpu(buf[i]);
+            acc += buf[i];
+        }
+        micro_sink = acc;
+    }
+    micro_report("be32_scalar", MICRO_CONVERT_ITERS, MICRO_CONVERT_DWORDS,
+                 now_ns() - t0, cycles_now() - c0);
+}
+
+static void bench_be32_bulk(uint32_t *buf) {
+    uint64_t t0 = 0, c0 = 0;
+    for (int iter = -MICRO_WARMUP_ITERATIONS; iter < MICRO_CONVERT_ITERS;
+         iter++) {
+        if (iter == 0) {
+            t0 = now_ns();
+            c0 = cycles_now();
+        }
+        be32_to_cpu_array(buf, MICRO_CONVERT_DWORDS);
+        micro_sink = buf[MICRO_CONVERT_DWORDS - 1];
+    }
+    micro_report("be32_bulk", MICRO_CONVERT_ITERS, MICRO_CONVERT_DWORDS,
+                 now_ns() - t0, cycles_now() - c0);
+}
+
+static void bench_be16_scalar(uint16_t *buf) {
+    uint64_t t0 = 0, c0 = 0;
+    for (int iter = -MICRO_WARMUP_ITERATIONS; iter < MICRO_CONVERT_ITERS;
+         iter++) {
+        if (iter == 0) {
+            t0 = now_ns();
+            c0 = cycles_now();
+        }
+        uint64_t acc = 0;
+        for (size_t i = 0; i < MICRO_CONVERT_DWORDS; i++) {
+            buf[i] = be16_to_cpu(buf[i]);
+            acc += buf[i];
+        }
+        micro_sink = acc;
+    }
+    micro_report("be16_scalar", MICRO_CONVERT_ITERS, MICRO_CONVERT_DWORDS,
+                 now_ns() - t0, cycles_now() - c0);
+}
+
+/*
+ * ---- Optional-header kernels ----
+ *
+ * Key dispatch binary-searches the sorted name table with a mix of
+ * known and unknown keys; header find is the linear xex_find_header
+ * scan over a 25-entry table, the common corpus shape.
+ */
+
+#define MICRO_DISPATCH_ITERS 200000
+
+static void bench_key_dispatch(void) {
+    static const uint32_t keys[8] = {
+        0x000003FF,     /* FILE_FORMAT_INFO */
+        0x00010100,     /* ENTRY_POINT */
+        0x000103FF,     /* IMPORT_LIBRARIES */
+        0x00040006,     /* EXECUTION_INFO */
+        0x000002FF,     /* RESOURCE_INFO */
+        0x12345678,     /* Unknown */
+        0x00020200,     /* DEFAULT_STACK_SIZE */
+        0xFFFFFFFF      /* Unknown */
+    };
+
+    uint64_t t0 = 0, c0 = 0;
+    for (int iter = -MICRO_WARMUP_ITERATIONS; iter < MICRO_DISPATCH_ITERS;
+         iter++) {
+        if (iter == 0) {
+            t0 = now_ns();
+            c0 = cycles_now();
+        }
+        uint64_t acc = 0;
+        for (size_t i = 0; i < 8; i++) {
+            acc += (uintptr_t)xex_header_key_name(keys[i]);
+        }
+        micro_sink = acc;
+    }
+    micro_report("header_key_dispatch", MICRO_DISPATCH_ITERS, 8,
+                 now_ns() - t0, cycles_now() - c0);
+}
+
+static void bench_header_find(void) {
+    XexOptHeader headers[25];
+    XexParsed parsed;
+    memset(&parsed, 0, sizeof(parsed));
+    for (uint32_t i = 0; i < 25; i++) {
+        headers[i].key = 0x00018002 + i;
+        headers[i].value = i;
+    }
+    headers[24].key = XEX_HEADER_FILE_FORMAT_INFO;
+    parsed.opt_headers = headers;
+    parsed.opt_count = 25;
+
+    uint64_t t0 = 0, c0 = 0;
+    for (int iter = -MICRO_WARMUP_ITERATIONS; iter < MICRO_DISPATCH_ITERS;
+         iter++) {
+        if (iter == 0) {
+            t0 = now_ns();
+            c0 = cycles_now();
+        }
+        micro_sink =
+            (uintptr_t)xex_find_header(&parsed, XEX_HEADER_FILE_FORMAT_INFO);
+    }
+    micro_report("opt_header_find", MICRO_DISPATCH_ITERS, 1,
+                 now_ns() - t0, cycles_now() - c0);
+}
+
+/*
+ * ---- Cache hit path ----
+ *
+ * One record is stored into a private cache directory, then looked up
+ * repeatedly: path hashing, the stat identity check, and record
+ * decode, with the record itself warm in the page cache.
+ */
+
+#define MICRO_CACHE_ITERS 20000
+
+/* Remove the record files from the private cache dir, then the dir */
+static void micro_cache_cleanup(const char *dir) {
+    DIR *d = opendir(dir);
+    if (d) {
+        struct dirent *entry;
+        while ((entry = readdir(d)) != NULL) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+static void bench_cache_hit(const char *xex_path) {
+    char cache_tmp[] = "/tmp/xextool-micro.XXXXXX";
+    if (!mkdtemp(cache_tmp)) {
+        fprintf(stderr, "SKIP cache_hit: cannot create cache dir\n");
+        return;
+    }
+
+    XexView view;
+    XexArena arena;
+    XexParsed parsed;
+    uint8_t arena_buf[4096];
+    if (xex_view_open(xex_path, &view, 1) != XEX_OK) {
+        fprintf(stderr, "SKIP cache_hit: cannot open '%s'\n", xex_path);
+        micro_cache_cleanup(cache_tmp);
+        return;
+    }
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    if (xex_parse(&view, &arena, &parsed) != XEX_OK) {
+        fprintf(stderr, "SKIP cache_hit: cannot parse '%s'\n", xex_path);
+        xex_view_close(&view);
+        xex_arena_release(&arena);
+        micro_cache_cleanup(cache_tmp);
+        return;
+    }
+    cache_store(cache_tmp, xex_path, &parsed);
+    xex_view_close(&view);
+    xex_arena_release(&arena);
+
+    uint64_t t0 = 0, c0 = 0;
+    for (int iter = -MICRO_WARMUP_ITERATIONS; iter < MICRO_CACHE_ITERS;
+         iter++) {
+        if (iter == 0) {
+            t0 = now_ns();
+            c0 = cycles_now();
+        }
+        XexArena hit_arena;
+        XexParsed hit;
+        size_t file_size;
+        uint8_t hit_buf[4096];
+        xex_arena_init(&hit_arena, hit_buf, sizeof(hit_buf));
+        if (cache_lookup(cache_tmp, xex_path, &hit_arena, &hit,
+                         &file_size) != XEX_OK) {
+            fprintf(stderr, "SKIP cache_hit: lookup missed\n");
+            micro_cache_cleanup(cache_tmp);
+            return;
+        }
+        micro_sink = hit.opt_count;
+        xex_arena_release(&hit_arena);
+    }
+    micro_report("cache_hit", MICRO_CACHE_ITERS, 1,
+                 now_ns() - t0, cycles_now() - c0);
+
+    micro_cache_cleanup(cache_tmp);
+}
+
+/*
+ * ---- Import hash lookups ----
+ *
+ * Library lookup by name is one hash probe over the parsed import
+ * table; ordinal lookup additionally needs the resolved symbol index,
+ * so it runs only when a decrypted basefile image is supplied.
+ */
+
+#define MICRO_LOOKUP_ITERS 500000
+
+static void bench_import_lookups(const char *xex_path,
+                                 const char *image_path) {
+    XexView view;
+    if (xex_view_open(xex_path, &view, 1) != XEX_OK) {
+        fprintf(stderr, "SKIP import lookups: cannot open '%s'\n", xex_path);
+        return;
+    }
+
+    XexArena arena;
+    XexParsed parsed;
+    XexImportTable table;
+    uint8_t *arena_buf = malloc(MICRO_IMPORT_ARENA_SIZE);
+    if (!arena_buf) {
+        xex_view_close(&view);
+        return;
+    }
+    xex_arena_init(&arena, arena_buf, MICRO_IMPORT_ARENA_SIZE);
+
+    if (xex_parse(&view, &arena, &parsed) != XEX_OK ||
+        xex_parse_imports(&view, &parsed, &arena, &table) != XEX_OK ||
+        table.library_count == 0) {
+        fprintf(stderr, "SKIP import lookups: no import table in '%s'\n",
+                xex_path);
+        goto out;
+    }
+    const char *name = table.libraries[0].name;
+
+    uint64_t t0 = 0, c0 = 0;
+    for (int iter = -MICRO_WARMUP_ITERATIONS; iter < MICRO_LOOKUP_ITERS;
+         iter++) {
+        if (iter == 0) {
+            t0 = now_ns();
+            c0 = cycles_now();
+        }
+        micro_sink = (uintptr_t)xex_import_find_library(&table, name);
+    }
+    micro_report("import_find_library", MICRO_LOOKUP_ITERS, 1,
+                 now_ns() - t0, cycles_now() - c0);
+
+    /* Ordinal lookups need the resolved symbol index */
+    if (image_path) {
+        int fd = open(image_path, O_RDONLY);
+        uint8_t *image = NULL;
+        off_t image_size = fd >= 0 ? lseek(fd, 0, SEEK_END) : -1;
+        if (image_size > 0) {
+            image = malloc((size_t)image_size);
+        }
+        if (image &&
+            pread(fd, image, (size_t)image_size, 0) == (ssize_t)image_size &&
+            xex_import_resolve(&table, &arena, image, (size_t)image_size,
+                               xex_load_address(&view, &parsed)) == XEX_OK &&
+            table.symbol_count > 0) {
+            uint32_t lib = table.symbols[0].library_index;
+            uint32_t ordinal = table.symbols[0].ordinal;
+
+            t0 = 0;
+            c0 = 0;
+            for (int iter = -MICRO_WARMUP_ITERATIONS;
+                 iter < MICRO_LOOKUP_ITERS; iter++) {
+                if (iter == 0) {
+                    t0 = now_ns();
+                    c0 = cycles_now();
+                }
+                micro_sink = (uintptr_t)xex_import_find_ordinal(&table, lib,
+                                                                ordinal);
+            }
+            micro_report("import_find_ordinal", MICRO_LOOKUP_ITERS, 1,
+                         now_ns() - t0, cycles_now() - c0);
+        } else {
+            fprintf(stderr, "SKIP import_find_ordinal: cannot resolve '%s'\n",
+                    image_path);
+        }
+        free(image);
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+out:
+    free(arena_buf);
+    xex_arena_release(&arena);
+    xex_view_close(&view);
+}
+
+int main(int argc, char *argv[]) {
+    const char *xex_path = argc > 1 ? argv[1] : NULL;
+    const char *image_path = argc > 2 ? argv[2] : NULL;
+
+    printf("=== xextool kernel microbenchmarks ===\n");
+    printf("%d warmup iterations per kernel; results written to %s\n\n",
+           MICRO_WARMUP_ITERATIONS, MICRO_RESULTS_FILE);
+
+    results_file = fopen(MICRO_RESULTS_FILE, "w");
+    if (!results_file) {
+        fprintf(stderr, "WARNING: cannot write %s\n", MICRO_RESULTS_FILE);
+    }
+
+    uint32_t *dwords = malloc(MICRO_CONVERT_DWORDS * sizeof(uint32_t));
+    uint16_t *words = malloc(MICRO_CONVERT_DWORDS * sizeof(uint16_t));
+    if (!dwords || !words) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return 1;
+    }
+    srand(1);   /* Fixed seed: identical input across commits */
+    for (size_t i = 0; i < MICRO_CONVERT_DWORDS; i++) {
+        dwords[i] = (uint32_t)rand();
+        words[i] = (uint16_t)rand();
+    }
+
+    bench_be32_scalar(dwords);
+    bench_be32_bulk(dwords);
+    bench_be16_scalar(words);
+    bench_key_dispatch();
+    bench_header_find();
+
+    if (xex_path) {
+        bench_cache_hit(xex_path);
+        bench_import_lookups(xex_path, image_path);
+    } else {
+        printf("(no image given: cache and import kernels skipped)\n");
+    }
+
+    free(dwords);
+    free(words);
+    if (results_file) {
+        fclose(results_file);
+    }
+    return 0;
+}
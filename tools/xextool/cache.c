@@ -0,0 +1,170 @@
+/*
+ * cache - persistent analysis cache
+ *
+ * Each record is one small binary file in the cache directory holding
+ * the file identity (size, mtime) and the parsed header summary
+ * including the full optional header table.  Records are written to a
+ * temporary file and renamed into place so concurrent scan workers
+ * never observe a torn record.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cache.h"
+
+#define CACHE_MAGIC   0x31414358   /* "XCA1" */
+#define CACHE_VERSION 1
+
+/* Fixed-size record header, followed by opt_count XexOptHeader entries */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t file_size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint32_t module_flags;
+    uint32_t pe_offset;
+    uint32_t security_offset;
+    uint32_t opt_count;
+    uint32_t has_file_format_info;
+    uint32_t file_format_info_offset;
+    uint32_t info_size;
+    uint16_t encryption_type;
+    uint16_t compression_type;
+} CacheRecord;
+
+/* FNV-1a hash of the canonical path names the record file */
+static uint64_t cache_hash_path(const char *path) {
+    char resolved[4096];
+    const char *key = realpath(path, resolved) ? resolved : path;
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* Build the record path for a file */
+static void cache_record_path(const char *cache_dir, const char *path,
+                              char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/%016llx.xc", cache_dir,
+             (unsigned long long)cache_hash_path(path));
+}
+
+/* Look up a cached record for path */
+int cache_lookup(const char *cache_dir, const char *path,
+                 XexArena *arena, XexParsed *parsed, size_t *file_size) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return XEX_ERR_IO;
+    }
+
+    char record_path[4096];
+    cache_record_path(cache_dir, path, record_path, sizeof(record_path));
+
+    int fd = open(record_path, O_RDONLY);
+    if (fd < 0) {
+        return XEX_ERR_IO;
+    }
+
+    CacheRecord rec;
+    struct stat rst;
+    if (read(fd, &rec, sizeof(rec)) != (ssize_t)sizeof(rec) ||
+        rec.magic != CACHE_MAGIC || rec.version != CACHE_VERSION ||
+        rec.file_size != (uint64_t)st.st_size ||
+        rec.mtime_sec != (int64_t)st.st_mtim.tv_sec ||
+        rec.mtime_nsec != (int64_t)st.st_mtim.tv_nsec ||
+        fstat(fd, &rst) != 0 ||
+        /* The declared table must account for the rest of the record */
+        (uint64_t)rst.st_size !=
+            sizeof(rec) + (uint64_t)rec.opt_count * sizeof(XexOptHeader)) {
+        close(fd);
+        return XEX_ERR_IO;
+    }
+
+    memset(parsed, 0, sizeof(*parsed));
+    parsed->module_flags = rec.module_flags;
+    parsed->pe_offset = rec.pe_offset;
+    parsed->security_offset = rec.security_offset;
+    parsed->has_file_format_info = (int)rec.has_file_format_info;
+    parsed->file_format_info_offset = rec.file_format_info_offset;
+    parsed->info_size = rec.info_size;
+    parsed->encryption_type = rec.encryption_type;
+    parsed->compression_type = rec.compression_type;
+
+    if (rec.opt_count > 0) {
+        XexOptHeader *table =
+            xex_arena_alloc(arena, rec.opt_count * sizeof(XexOptHeader));
+        if (!table ||
+            read(fd, table, rec.opt_count * sizeof(XexOptHeader)) !=
+                (ssize_t)(rec.opt_count * sizeof(XexOptHeader))) {
+            close(fd);
+            return XEX_ERR_IO;
+        }
+        parsed->opt_headers = table;
+        parsed->opt_count = rec.opt_count;
+    }
+
+    close(fd);
+    *file_size = (size_t)st.st_size;
+    return XEX_OK;
+}
+
+/* Store a parsed summary for path */
+void cache_store(const char *cache_dir, const char *path,
+                 const XexParsed *parsed) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return;
+    }
+
+    CacheRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = CACHE_MAGIC;
+    rec.version = CACHE_VERSION;
+    rec.file_size = (uint64_t)st.st_size;
+    rec.mtime_sec = (int64_t)st.st_mtim.tv_sec;
+    rec.mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+    rec.module_flags = parsed->module_flags;
+    rec.pe_offset = parsed->pe_offset;
+    rec.security_offset = parsed->security_offset;
+    rec.opt_count = parsed->opt_count;
+    rec.has_file_format_info = (uint32_t)parsed->has_file_format_info;
+    rec.file_format_info_offset = parsed->file_format_info_offset;
+    rec.info_size = parsed->info_size;
+    rec.encryption_type = parsed->encryption_type;
+    rec.compression_type = parsed->compression_type;
+
+    char record_path[4096];
+    cache_record_path(cache_dir, path, record_path, sizeof(record_path));
+
+    /* Write to a temporary file and rename into place */
+    char tmp_path[4160];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.XXXXXX", record_path);
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        return;
+    }
+
+    int ok = write(fd, &rec, sizeof(rec)) == (ssize_t)sizeof(rec);
+    if (ok && parsed->opt_count > 0) {
+        ok = write(fd, parsed->opt_headers,
+                   parsed->opt_count * sizeof(XexOptHeader)) ==
+             (ssize_t)(parsed->opt_count * sizeof(XexOptHeader));
+    }
+    close(fd);
+
+    if (!ok || rename(tmp_path, record_path) != 0) {
+        unlink(tmp_path);
+    }
+}
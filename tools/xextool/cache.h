@@ -0,0 +1,28 @@
+/*
+ * cache - persistent analysis cache
+ *
+ * On-disk cache of parsed header summaries keyed by file identity
+ * (path, size, mtime).  Repeat scans of an unchanged corpus become a
+ * stat plus one small read instead of a full parse.  Records are
+ * compact binary files named by a hash of the canonical path.
+ */
+
+#ifndef XEXTOOL_CACHE_H
+#define XEXTOOL_CACHE_H
+
+#include "xex.h"
+
+/*
+ * Look up a cached record for path.  On a hit the parsed summary is
+ * reconstructed (optional headers allocated from arena), file_size is
+ * set, and XEX_OK is returned.  Any mismatch in size or mtime is a
+ * miss; misses return nonzero.
+ */
+int cache_lookup(const char *cache_dir, const char *path,
+                 XexArena *arena, XexParsed *parsed, size_t *file_size);
+
+/* Store a parsed summary for path; failures are silently ignored */
+void cache_store(const char *cache_dir, const char *path,
+                 const XexParsed *parsed);
+
+#endif /* XEXTOOL_CACHE_H */
@@ -0,0 +1,475 @@
+/*
+ * lzx - LZX decompression engine
+ *
+ * Implements the LZX format as used by XEX_COMPRESSION_NORMAL images:
+ * a 16-bit-word bitstream carrying huffman-coded literals and matches
+ * against a sliding window, organized in verbatim, aligned-offset and
+ * uncompressed blocks, with optional E8 call-instruction translation.
+ *
+ * The decoder is streaming in spirit - it consumes the input one block
+ * at a time and writes straight into the output buffer, which doubles
+ * as the match window.
+ */
+
+#include <string.h>
+
+#include "lzx.h"
+
+/* Tree sizes from the LZX specification */
+#define LZX_PRETREE_SYMBOLS      20
+#define LZX_LITERAL_SYMBOLS      256
+#define LZX_LENGTH_SYMBOLS       249
+#define LZX_ALIGNED_SYMBOLS      8
+#define LZX_MAX_POSITION_SLOTS   50
+#define LZX_MAIN_SYMBOLS_MAX     (LZX_LITERAL_SYMBOLS + LZX_MAX_POSITION_SLOTS * 8)
+#define LZX_MAX_CODE_LENGTH      16
+#define LZX_FRAME_SIZE           32768
+
+/* Block types */
+#define LZX_BLOCK_VERBATIM       1
+#define LZX_BLOCK_ALIGNED        2
+#define LZX_BLOCK_UNCOMPRESSED   3
+
+/* Bitstream: 16-bit little-endian words, bits consumed MSB-first */
+typedef struct {
+    const uint8_t *in;
+    size_t size;
+    size_t pos;          /* Next byte to load */
+    uint64_t bitbuf;     /* Valid bits in the low end */
+    int bitcount;
+} LzxBits;
+
+/* Canonical huffman decoding table built from code lengths */
+typedef struct {
+    int symbols;
+    uint8_t length[LZX_MAIN_SYMBOLS_MAX];
+    /* Per-bit-length canonical decode data */
+    uint16_t count[LZX_MAX_CODE_LENGTH + 1];
+    uint32_t first_code[LZX_MAX_CODE_LENGTH + 1];
+    uint16_t first_index[LZX_MAX_CODE_LENGTH + 1];
+    uint16_t sorted[LZX_MAIN_SYMBOLS_MAX];
+    int empty;           /* All code lengths zero */
+} LzxTree;
+
+/* Full decoder state */
+typedef struct {
+    LzxBits bits;
+    uint8_t *out;
+    size_t out_size;
+    size_t out_pos;
+    int position_slots;
+    uint32_t R0, R1, R2;          /* Recent match offsets */
+    int intel_filesize;           /* E8 translation size (0 = off) */
+    LzxTree main_tree;
+    LzxTree length_tree;
+    LzxTree aligned_tree;
+    LzxTree pretree;
+} LzxState;
+
+/* Position slot bases and extra-bit counts, filled at init */
+static void lzx_init_position_table(uint32_t *base, uint8_t *extra, int slots) {
+    uint32_t cum = 0;
+    for (int i = 0; i < slots; i++) {
+        int eb = (i >> 1) - 1;
+        if (eb < 0) {
+            eb = 0;
+        } else if (eb > 17) {
+            eb = 17;
+        }
+        extra[i] = (uint8_t)eb;
+        base[i] = cum;
+        cum += (uint32_t)1 << eb;
+    }
+}
+
+/* Ensure at least n bits are buffered (missing input reads as zero) */
+static void lzx_ensure_bits(LzxBits *bs, int n) {
+    while (bs->bitcount < n) {
+        uint32_t word = 0;
+        if (bs->pos + 1 < bs->size) {
+            word = (uint32_t)bs->in[bs->pos] | ((uint32_t)bs->in[bs->pos + 1] << 8);
+            bs->pos += 2;
+        } else if (bs->pos < bs->size) {
+            word = bs->in[bs->pos];
+            bs->pos += 1;
+        }
+        bs->bitbuf = (bs->bitbuf << 16) | word;
+        bs->bitcount += 16;
+    }
+}
+
+/* Read n bits (n <= 17) */
+static uint32_t lzx_read_bits(LzxBits *bs, int n) {
+    if (n == 0) {
+        return 0;
+    }
+    lzx_ensure_bits(bs, n);
+    uint32_t val = (uint32_t)(bs->bitbuf >> (bs->bitcount - n)) &
+                   (((uint32_t)1 << n) - 1);
+    bs->bitcount -= n;
+    return val;
+}
+
+/* Build canonical decode tables from tree->length[] */
+static int lzx_build_tree(LzxTree *tree) {
+    memset(tree->count, 0, sizeof(tree->count));
+    tree->empty = 1;
+
+    for (int i = 0; i < tree->symbols; i++) {
+        if (tree->length[i] > LZX_MAX_CODE_LENGTH) {
+            return LZX_ERR_DATA;
+        }
+        tree->count[tree->length[i]]++;
+        if (tree->length[i] > 0) {
+            tree->empty = 0;
+        }
+    }
+    if (tree->empty) {
+        return LZX_OK;
+    }
+
+    /* Canonical codes: first code and first sorted index per length */
+    uint32_t code = 0;
+    uint16_t index = 0;
+    uint16_t next_index[LZX_MAX_CODE_LENGTH + 1];
+    for (int len = 1; len <= LZX_MAX_CODE_LENGTH; len++) {
+        tree->first_code[len] = code;
+        tree->first_index[len] = index;
+        next_index[len] = index;
+        index = (uint16_t)(index + tree->count[len]);
+        code = (code + tree->count[len]) << 1;
+    }
+
+    /* Sort symbols by (length, symbol) for index lookup */
+    for (int i = 0; i < tree->symbols; i++) {
+        if (tree->length[i] > 0) {
+            tree->sorted[next_index[tree->length[i]]++] = (uint16_t)i;
+        }
+    }
+    return LZX_OK;
+}
+
+/* Decode one symbol from a tree */
+static int lzx_decode_symbol(LzxBits *bs, const LzxTree *tree) {
+    if (tree->empty) {
+        return -1;
+    }
+    uint32_t code = 0;
+    for (int len = 1; len <= LZX_MAX_CODE_LENGTH; len++) {
+        code = (code << 1) | lzx_read_bits(bs, 1);
+        uint32_t offset = code - tree->first_code[len];
+        if (offset < tree->count[len]) {
+            return tree->sorted[tree->first_index[len] + offset];
+        }
+    }
+    return -1;
+}
+
+/* Read delta-encoded code lengths for tree symbols [first, last) */
+static int lzx_read_lengths(LzxState *st, LzxTree *tree, int first, int last) {
+    /* The lengths are themselves huffman coded with a 20-symbol pretree */
+    st->pretree.symbols = LZX_PRETREE_SYMBOLS;
+    for (int i = 0; i < LZX_PRETREE_SYMBOLS; i++) {
+        st->pretree.length[i] = (uint8_t)lzx_read_bits(&st->bits, 4);
+    }
+    if (lzx_build_tree(&st->pretree) != LZX_OK) {
+        return LZX_ERR_DATA;
+    }
+
+    int i = first;
+    while (i < last) {
+        int sym = lzx_decode_symbol(&st->bits, &st->pretree);
+        if (sym < 0) {
+            return LZX_ERR_DATA;
+        }
+        if (sym == 17) {
+            /* Run of zero lengths, 4-19 */
+            int run = 4 + (int)lzx_read_bits(&st->bits, 4);
+            while (run-- > 0 && i < last) {
+                tree->length[i++] = 0;
+            }
+        } else if (sym == 18) {
+            /* Run of zero lengths, 20-51 */
+            int run = 20 + (int)lzx_read_bits(&st->bits, 5);
+            while (run-- > 0 && i < last) {
+                tree->length[i++] = 0;
+            }
+        } else if (sym == 19) {
+            /* Short run of one repeated length, 4-5 */
+            int run = 4 + (int)lzx_read_bits(&st->bits, 1);
+            int sym2 = lzx_decode_symbol(&st->bits, &st->pretree);
+            if (sym2 < 0 || sym2 > 16) {
+                return LZX_ERR_DATA;
+            }
+            int value = (tree->length[i] - sym2 + 17) % 17;
+            while (run-- > 0 && i < last) {
+                tree->length[i++] = (uint8_t)value;
+            }
+        } else {
+            /* Delta from the previous tree's length at this position */
+            int value = (tree->length[i] - sym + 17) % 17;
+            tree->length[i++] = (uint8_t)value;
+        }
+    }
+    return LZX_OK;
+}
+
+/* Copy a match from the window (the output buffer itself) */
+static int lzx_copy_match(LzxState *st, uint32_t offset, uint32_t length) {
+    if (offset == 0 || offset > st->out_pos ||
+        st->out_pos + length > st->out_size) {
+        return LZX_ERR_DATA;
+    }
+    /* Byte-wise copy: source and destination may overlap */
+    uint8_t *dst = st->out + st->out_pos;
+    const uint8_t *src = dst - offset;
+    for (uint32_t i = 0; i < length; i++) {
+        dst[i] = src[i];
+    }
+    st->out_pos += length;
+    return LZX_OK;
+}
+
+/* Undo E8 call-instruction translation over the decompressed output */
+static void lzx_undo_e8(uint8_t *out, size_t out_size, int32_t filesize) {
+    if (filesize == 0 || out_size <= 10) {
+        return;
+    }
+    size_t end = out_size - 10;
+    for (size_t frame = 0; frame < end; frame += LZX_FRAME_SIZE) {
+        size_t frame_end = frame + LZX_FRAME_SIZE - 10;
+        if (frame_end > end) {
+            frame_end = end;
+        }
+        for (size_t i = frame; i < frame_end; ) {
+            if (out[i] != 0xE8) {
+                i++;
+                continue;
+            }
+            int32_t cur = (int32_t)i;
+            int32_t abs = (int32_t)((uint32_t)out[i + 1] |
+                                    ((uint32_t)out[i + 2] << 8) |
+                                    ((uint32_t)out[i + 3] << 16) |
+                                    ((uint32_t)out[i + 4] << 24));
+            if (abs >= -cur && abs < filesize) {
+                int32_t rel = (abs >= 0) ? abs - cur : abs + filesize;
+                out[i + 1] = (uint8_t)(rel & 0xFF);
+                out[i + 2] = (uint8_t)((rel >> 8) & 0xFF);
+                out[i + 3] = (uint8_t)((rel >> 16) & 0xFF);
+                out[i + 4] = (uint8_t)((rel >> 24) & 0xFF);
+            }
+            i += 5;
+        }
+    }
+}
+
+/* Decode one verbatim or aligned block body of block_size output bytes */
+static int lzx_decode_block(LzxState *st, int block_type, uint32_t block_size,
+                            const uint32_t *pos_base, const uint8_t *pos_extra) {
+    uint32_t remaining = block_size;
+
+    while (remaining > 0) {
+        int sym = lzx_decode_symbol(&st->bits, &st->main_tree);
+        if (sym < 0) {
+            return LZX_ERR_DATA;
+        }
+
+        if (sym < LZX_LITERAL_SYMBOLS) {
+            /* Literal byte */
+            if (st->out_pos >= st->out_size) {
+                return LZX_ERR_OUTPUT;
+            }
+            st->out[st->out_pos++] = (uint8_t)sym;
+            remaining--;
+            continue;
+        }
+
+        /* Match: length footer and position slot packed in the symbol */
+        sym -= LZX_LITERAL_SYMBOLS;
+        uint32_t length = (uint32_t)(sym & 7);
+        int slot = sym >> 3;
+        if (length == 7) {
+            int footer = lzx_decode_symbol(&st->bits, &st->length_tree);
+            if (footer < 0) {
+                return LZX_ERR_DATA;
+            }
+            length += (uint32_t)footer;
+        }
+        length += 2;
+
+        uint32_t offset;
+        if (slot == 0) {
+            offset = st->R0;
+        } else if (slot == 1) {
+            offset = st->R1;
+            st->R1 = st->R0;
+            st->R0 = offset;
+        } else if (slot == 2) {
+            offset = st->R2;
+            st->R2 = st->R0;
+            st->R0 = offset;
+        } else {
+            if (slot >= st->position_slots) {
+                return LZX_ERR_DATA;
+            }
+            int eb = pos_extra[slot];
+            uint32_t formatted;
+            if (block_type == LZX_BLOCK_ALIGNED && eb >= 3) {
+                /* Low 3 bits come from the aligned-offset tree */
+                uint32_t verbatim = lzx_read_bits(&st->bits, eb - 3);
+                int aligned = lzx_decode_symbol(&st->bits, &st->aligned_tree);
+                if (aligned < 0) {
+                    return LZX_ERR_DATA;
+                }
+                formatted = pos_base[slot] + (verbatim << 3) + (uint32_t)aligned;
+            } else {
+                formatted = pos_base[slot] + lzx_read_bits(&st->bits, eb);
+            }
+            offset = formatted - 2;
+            st->R2 = st->R1;
+            st->R1 = st->R0;
+            st->R0 = offset;
+        }
+
+        if (length > remaining) {
+            return LZX_ERR_DATA;
+        }
+        int ret = lzx_copy_match(st, offset, length);
+        if (ret != LZX_OK) {
+            return ret;
+        }
+        remaining -= length;
+    }
+    return LZX_OK;
+}
+
+/* Decompress an LZX stream */
+int lzx_decompress(const uint8_t *in, size_t in_size,
+                   uint8_t *out, size_t out_size,
+                   uint32_t window_size) {
+    LzxState st;
+    uint32_t pos_base[LZX_MAX_POSITION_SLOTS];
+    uint8_t pos_extra[LZX_MAX_POSITION_SLOTS];
+
+    /* Window must be a power of two between 32KB and 2MB */
+    int wbits = 0;
+    for (int i = 15; i <= 21; i++) {
+        if (window_size == ((uint32_t)1 << i)) {
+            wbits = i;
+            break;
+        }
+    }
+    if (wbits == 0) {
+        return LZX_ERR_WINDOW;
+    }
+
+    memset(&st, 0, sizeof(st));
+    st.bits.in = in;
+    st.bits.size = in_size;
+    st.out = out;
+    st.out_size = out_size;
+    st.R0 = st.R1 = st.R2 = 1;
+
+    /* Position slot count by window size (from the specification) */
+    switch (wbits) {
+        case 15: st.position_slots = 30; break;
+        case 16: st.position_slots = 32; break;
+        case 17: st.position_slots = 34; break;
+        case 18: st.position_slots = 36; break;
+        case 19: st.position_slots = 38; break;
+        case 20: st.position_slots = 42; break;
+        default: st.position_slots = 50; break;
+    }
+    lzx_init_position_table(pos_base, pos_extra, st.position_slots);
+
+    st.main_tree.symbols = LZX_LITERAL_SYMBOLS + st.position_slots * 8;
+    st.length_tree.symbols = LZX_LENGTH_SYMBOLS;
+    st.aligned_tree.symbols = LZX_ALIGNED_SYMBOLS;
+
+    /* Stream header: optional E8 translation size */
+    if (lzx_read_bits(&st.bits, 1)) {
+        uint32_t hi = lzx_read_bits(&st.bits, 16);
+        uint32_t lo = lzx_read_bits(&st.bits, 16);
+        st.intel_filesize = (int32_t)((hi << 16) | lo);
+    }
+
+    while (st.out_pos < st.out_size) {
+        int block_type = (int)lzx_read_bits(&st.bits, 3);
+        uint32_t block_size = (lzx_read_bits(&st.bits, 16) << 8) |
+                              lzx_read_bits(&st.bits, 8);
+        if (block_size == 0 || st.out_pos + block_size > st.out_size) {
+            return LZX_ERR_DATA;
+        }
+
+        if (block_type == LZX_BLOCK_UNCOMPRESSED) {
+            /* Align the stream to a 16-bit boundary, then raw bytes */
+            int pad = st.bits.bitcount & 15;
+            if (pad == 0) {
+                lzx_read_bits(&st.bits, 16);
+            } else {
+                lzx_read_bits(&st.bits, pad);
+            }
+            size_t byte_pos = st.bits.pos - (size_t)(st.bits.bitcount / 8);
+            if (byte_pos + 12 + block_size > in_size) {
+                return LZX_ERR_DATA;
+            }
+            /* 12 bytes of little-endian R0/R1/R2, then the block body */
+            const uint8_t *p = in + byte_pos;
+            st.R0 = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+            st.R1 = (uint32_t)p[4] | ((uint32_t)p[5] << 8) |
+                    ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+            st.R2 = (uint32_t)p[8] | ((uint32_t)p[9] << 8) |
+                    ((uint32_t)p[10] << 16) | ((uint32_t)p[11] << 24);
+            memcpy(st.out + st.out_pos, p + 12, block_size);
+            st.out_pos += block_size;
+
+            /* Resume the bitstream after the (word-padded) block body */
+            byte_pos += 12 + block_size;
+            byte_pos += byte_pos & 1;
+            st.bits.pos = byte_pos;
+            st.bits.bitbuf = 0;
+            st.bits.bitcount = 0;
+        } else if (block_type == LZX_BLOCK_VERBATIM ||
+                   block_type == LZX_BLOCK_ALIGNED) {
+            if (block_type == LZX_BLOCK_ALIGNED) {
+                for (int i = 0; i < LZX_ALIGNED_SYMBOLS; i++) {
+                    st.aligned_tree.length[i] = (uint8_t)lzx_read_bits(&st.bits, 3);
+                }
+                if (lzx_build_tree(&st.aligned_tree) != LZX_OK) {
+                    return LZX_ERR_DATA;
+                }
+            }
+
+            /* Main tree arrives in two length runs, then the length tree */
+            int ret;
+            if ((ret = lzx_read_lengths(&st, &st.main_tree, 0,
+                                        LZX_LITERAL_SYMBOLS)) != LZX_OK ||
+                (ret = lzx_read_lengths(&st, &st.main_tree, LZX_LITERAL_SYMBOLS,
+                                        st.main_tree.symbols)) != LZX_OK) {
+                return ret;
+            }
+            if (lzx_build_tree(&st.main_tree) != LZX_OK) {
+                return LZX_ERR_DATA;
+            }
+            if ((ret = lzx_read_lengths(&st, &st.length_tree, 0,
+                                        LZX_LENGTH_SYMBOLS)) != LZX_OK) {
+                return ret;
+            }
+            if (lzx_build_tree(&st.length_tree) != LZX_OK) {
+                return LZX_ERR_DATA;
+            }
+
+            ret = lzx_decode_block(&st, block_type, block_size,
+                                   pos_base, pos_extra);
+            if (ret != LZX_OK) {
+                return ret;
+            }
+        } else {
+            return LZX_ERR_DATA;
+        }
+    }
+
+    lzx_undo_e8(out, out_size, st.intel_filesize);
+    return LZX_OK;
+}
@@ -0,0 +1,31 @@
+/*
+ * lzx - LZX decompression engine
+ *
+ * Decoder for the LZX bitstream used by XEX_COMPRESSION_NORMAL images
+ * (the same format as Microsoft cabinet LZX). Self-contained, no
+ * external dependencies; see lzx.c for the format walkthrough.
+ */
+
+#ifndef XEXTOOL_LZX_H
+#define XEXTOOL_LZX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Status codes */
+#define LZX_OK          0
+#define LZX_ERR_WINDOW  1   /* Unsupported window size */
+#define LZX_ERR_DATA    2   /* Corrupt bitstream */
+#define LZX_ERR_OUTPUT  3   /* Output buffer too small */
+
+/*
+ * Decompress an LZX stream.  in/in_size is the complete compressed
+ * stream, out/out_size the expected uncompressed image.  window_size
+ * must be a power of two between 32KB and 2MB (from the XEX
+ * FILE_FORMAT_INFO normal-compression descriptor).
+ */
+int lzx_decompress(const uint8_t *in, size_t in_size,
+                   uint8_t *out, size_t out_size,
+                   uint32_t window_size);
+
+#endif /* XEXTOOL_LZX_H */
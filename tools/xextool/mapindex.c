@@ -0,0 +1,202 @@
+/*
+ * mapindex - binary symbol index for linker map files
+ *
+ * The builder scans the map once, collecting every "segment:offset
+ * name rva+base" symbol line, sorts the records by address and writes
+ * the sidecar in one pass.  Lookups mmap the sidecar and binary-search
+ * the entry table; there is no startup parse at all.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mapindex.h"
+
+/* One symbol collected during the build pass */
+typedef struct {
+    uint32_t address;
+    uint32_t name_offset;
+} BuildEntry;
+
+/* Growing symbol and string-pool buffers */
+typedef struct {
+    BuildEntry *entries;
+    size_t count;
+    size_t capacity;
+    char *strings;
+    size_t strings_len;
+    size_t strings_cap;
+} Builder;
+
+static int builder_add(Builder *b, uint32_t address, const char *name) {
+    if (b->count == b->capacity) {
+        size_t cap = b->capacity ? b->capacity * 2 : 1024;
+        BuildEntry *grown = realloc(b->entries, cap * sizeof(BuildEntry));
+        if (!grown) {
+            return 1;
+        }
+        b->entries = grown;
+        b->capacity = cap;
+    }
+
+    size_t len = strlen(name) + 1;
+    if (b->strings_len + len > b->strings_cap) {
+        size_t cap = b->strings_cap ? b->strings_cap * 2 : 16384;
+        while (cap < b->strings_len + len) {
+            cap *= 2;
+        }
+        char *grown = realloc(b->strings, cap);
+        if (!grown) {
+            return 1;
+        }
+        b->strings = grown;
+        b->strings_cap = cap;
+    }
+
+    b->entries[b->count].address = address;
+    b->entries[b->count].name_offset = (uint32_t)b->strings_len;
+    memcpy(b->strings + b->strings_len, name, len);
+    b->strings_len += len;
+    b->count++;
+    return 0;
+}
+
+/* Sort by address */
+static int entry_cmp(const void *a, const void *b) {
+    uint32_t aa = ((const BuildEntry *)a)->address;
+    uint32_t bb = ((const BuildEntry *)b)->address;
+    return (aa > bb) - (aa < bb);
+}
+
+/* Compile map_path into the binary sidecar at out_path */
+int mapindex_build(const char *map_path, const char *out_path) {
+    FILE *fp = fopen(map_path, "r");
+    if (!fp) {
+        return 1;
+    }
+
+    Builder b;
+    memset(&b, 0, sizeof(b));
+
+    /*
+     * Symbol lines look like:
+     *   0003:0002ba28  _main  8202ba28  dolphin.obj
+     * The third column (rva+base) is the address we index; zero means
+     * an absolute/non-loaded symbol and is skipped.
+     */
+    char line[1024];
+    int failed = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned segment, offset, rva;
+        char name[512];
+        if (sscanf(line, " %4x:%8x %511s %8x",
+                   &segment, &offset, name, &rva) == 4 && rva != 0) {
+            if (builder_add(&b, (uint32_t)rva, name) != 0) {
+                failed = 1;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+
+    if (failed || b.count == 0) {
+        free(b.entries);
+        free(b.strings);
+        return 1;
+    }
+
+    qsort(b.entries, b.count, sizeof(BuildEntry), entry_cmp);
+
+    /* Write header, entries and string pool in one pass */
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        free(b.entries);
+        free(b.strings);
+        return 1;
+    }
+
+    MapIndexHeader header;
+    header.magic = MAPINDEX_MAGIC;
+    header.symbol_count = (uint32_t)b.count;
+    header.strings_size = (uint32_t)b.strings_len;
+    header.reserved = 0;
+
+    int ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+             fwrite(b.entries, sizeof(BuildEntry), b.count, out) == b.count &&
+             fwrite(b.strings, 1, b.strings_len, out) == b.strings_len;
+    if (fclose(out) != 0) {
+        ok = 0;
+    }
+
+    free(b.entries);
+    free(b.strings);
+    if (!ok) {
+        unlink(out_path);
+    }
+    return ok ? 0 : 1;
+}
+
+/* Look up the symbol at or preceding address in a sidecar */
+int mapindex_lookup(const char *idx_path, uint32_t address,
+                    char *name_out, size_t name_out_size,
+                    uint32_t *symbol_address) {
+    int fd = open(idx_path, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MapIndexHeader)) {
+        close(fd);
+        return 1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return 1;
+    }
+
+    int ret = 1;
+    const MapIndexHeader *header = (const MapIndexHeader *)map;
+    const MapIndexEntry *entries =
+        (const MapIndexEntry *)((const uint8_t *)map + sizeof(MapIndexHeader));
+    const char *strings = (const char *)(entries + header->symbol_count);
+
+    if (header->magic == MAPINDEX_MAGIC &&
+        sizeof(MapIndexHeader) +
+            header->symbol_count * sizeof(MapIndexEntry) +
+            header->strings_size <= (size_t)st.st_size &&
+        header->symbol_count > 0 && entries[0].address <= address) {
+
+        /* Binary search for the last entry with address <= target */
+        uint32_t lo = 0, hi = header->symbol_count;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (entries[mid].address <= address) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        if (entries[lo].name_offset < header->strings_size) {
+            snprintf(name_out, name_out_size, "%s",
+                     strings + entries[lo].name_offset);
+            if (symbol_address) {
+                *symbol_address = entries[lo].address;
+            }
+            ret = 0;
+        }
+    }
+
+    munmap(map, (size_t)st.st_size);
+    return ret;
+}
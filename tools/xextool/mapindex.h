@@ -0,0 +1,44 @@
+/*
+ * mapindex - binary symbol index for linker map files
+ *
+ * Compiles a plain-text linker .map (like dolphin/dolphin.map) into a
+ * compact binary sidecar holding a sorted address->symbol table plus a
+ * string pool.  The sidecar is mmap'd and binary-searched directly, so
+ * naming an address costs one lookup instead of re-parsing the map at
+ * every tool startup.
+ */
+
+#ifndef XEXTOOL_MAPINDEX_H
+#define XEXTOOL_MAPINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Sidecar layout: header, sorted entries, string pool */
+#define MAPINDEX_MAGIC 0x31494D58   /* "XMI1" */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t symbol_count;
+    uint32_t strings_size;
+    uint32_t reserved;
+} MapIndexHeader;
+
+typedef struct {
+    uint32_t address;
+    uint32_t name_offset;   /* Into the string pool */
+} MapIndexEntry;
+
+/* Compile map_path into the binary sidecar at out_path */
+int mapindex_build(const char *map_path, const char *out_path);
+
+/*
+ * Look up the symbol at or preceding address in a sidecar.  Writes the
+ * name into name_out and returns 0, or nonzero when the index cannot
+ * be read or the address precedes every symbol.
+ */
+int mapindex_lookup(const char *idx_path, uint32_t address,
+                    char *name_out, size_t name_out_size,
+                    uint32_t *symbol_address);
+
+#endif /* XEXTOOL_MAPINDEX_H */
@@ -0,0 +1,186 @@
+/*
+ * pyxextool - CPython extension wrapping libxextool
+ *
+ * Gives Python orchestration (xenia_automation.py and the queue
+ * drivers) direct access to the parser instead of spawning the xextool
+ * binary and scraping stdout.  The GIL is released around all file
+ * I/O and parsing, so Python threads parse in parallel.
+ *
+ * Build with `make python`; `import pyxextool` then offers:
+ *   parse(path) -> dict          (same fields as the --json record)
+ *   extract_basefile(path, out)  (raises OSError/ValueError on failure)
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "xex.h"
+
+/* Fixed first block of the parse arena; it grows for larger tables */
+#define PY_PARSE_ARENA_SIZE 1024
+
+/* Set a dict item, stealing the value reference */
+static int dict_set(PyObject *dict, const char *key, PyObject *value) {
+    if (!value) {
+        return -1;
+    }
+    int ret = PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+    return ret;
+}
+
+/* parse(path) -> dict */
+static PyObject *py_parse(PyObject *self, PyObject *args) {
+    (void)self;
+    const char *path;
+    if (!PyArg_ParseTuple(args, "s", &path)) {
+        return NULL;
+    }
+
+    XexView view;
+    XexArena arena;
+    XexParsed parsed;
+    uint8_t arena_buf[PY_PARSE_ARENA_SIZE];
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    status = xex_view_open(path, &view, 1);
+    if (status == XEX_OK) {
+        status = xex_parse(&view, &arena, &parsed);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (status == XEX_ERR_IO) {
+        xex_arena_release(&arena);
+        return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    }
+
+    PyObject *result = PyDict_New();
+    if (!result) {
+        xex_view_close(&view);
+        xex_arena_release(&arena);
+        return NULL;
+    }
+
+    int failed = 0;
+    failed |= dict_set(result, "file", PyUnicode_FromString(path)) < 0;
+    failed |= dict_set(result, "size", PyLong_FromSize_t(view.size)) < 0;
+    failed |= dict_set(result, "valid",
+                       PyBool_FromLong(status == XEX_OK)) < 0;
+
+    if (status == XEX_OK) {
+        failed |= dict_set(result, "module_flags",
+                           PyLong_FromUnsignedLong(parsed.module_flags)) < 0;
+        failed |= dict_set(result, "pe_offset",
+                           PyLong_FromUnsignedLong(parsed.pe_offset)) < 0;
+        failed |= dict_set(result, "security_offset",
+                           PyLong_FromUnsignedLong(parsed.security_offset)) < 0;
+
+        PyObject *headers = PyList_New(0);
+        if (headers) {
+            for (uint32_t i = 0; i < parsed.opt_count; i++) {
+                const char *name =
+                    xex_header_key_name(parsed.opt_headers[i].key);
+                PyObject *entry = Py_BuildValue(
+                    "{s:I,s:I,s:s}",
+                    "key", parsed.opt_headers[i].key,
+                    "value", parsed.opt_headers[i].value,
+                    "name", name ? name : "");
+                if (!entry || PyList_Append(headers, entry) < 0) {
+                    failed = 1;
+                    Py_XDECREF(entry);
+                    break;
+                }
+                Py_DECREF(entry);
+            }
+            failed |= PyDict_SetItemString(result, "optional_headers",
+                                           headers) < 0;
+            Py_DECREF(headers);
+        } else {
+            failed = 1;
+        }
+
+        if (parsed.has_file_format_info) {
+            failed |= dict_set(result, "encryption", Py_BuildValue(
+                    "{s:I,s:s}",
+                    "type", (unsigned)parsed.encryption_type,
+                    "name", get_encryption_name(parsed.encryption_type))) < 0;
+            failed |= dict_set(result, "compression", Py_BuildValue(
+                    "{s:I,s:s}",
+                    "type", (unsigned)parsed.compression_type,
+                    "name", get_compression_name(parsed.compression_type))) < 0;
+        }
+    }
+
+    xex_view_close(&view);
+    xex_arena_release(&arena);
+
+    if (failed) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+/* extract_basefile(path, out) -> None */
+static PyObject *py_extract_basefile(PyObject *self, PyObject *args) {
+    (void)self;
+    const char *path;
+    const char *out_path;
+    if (!PyArg_ParseTuple(args, "ss", &path, &out_path)) {
+        return NULL;
+    }
+
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    XexView view;
+    XexArena arena;
+    XexParsed parsed;
+    uint8_t arena_buf[PY_PARSE_ARENA_SIZE];
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    status = xex_view_open(path, &view, 1);
+    if (status == XEX_OK) {
+        status = xex_parse(&view, &arena, &parsed);
+        if (status == XEX_OK) {
+            status = xex_extract_basefile_zerocopy(path, &parsed, out_path);
+            if (status == XEX_ERR_UNSUPPORTED) {
+                status = xex_extract_basefile(&view, &parsed, out_path);
+            }
+        }
+        xex_view_close(&view);
+    }
+    xex_arena_release(&arena);
+    Py_END_ALLOW_THREADS
+
+    if (status == XEX_ERR_IO) {
+        return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    }
+    if (status != XEX_OK) {
+        PyErr_SetString(PyExc_ValueError, xex_strerror(status));
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef pyxextool_methods[] = {
+    { "parse", py_parse, METH_VARARGS,
+      "parse(path) -> dict with the XEX header summary" },
+    { "extract_basefile", py_extract_basefile, METH_VARARGS,
+      "extract_basefile(path, out) -> extract the PE basefile" },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef pyxextool_module = {
+    PyModuleDef_HEAD_INIT,
+    "pyxextool",
+    "Native bindings for the xextool parsing library",
+    -1,
+    pyxextool_methods,
+    NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_pyxextool(void) {
+    return PyModule_Create(&pyxextool_module);
+}
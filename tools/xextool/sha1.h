@@ -0,0 +1,33 @@
+/*
+ * sha1 - SHA-1 for image digest verification
+ *
+ * Streaming context API plus a one-shot helper.  The compression
+ * function uses the SHA-NI instructions when the CPU has them and a
+ * portable software implementation otherwise, mirroring the AES-NI
+ * dispatch in aes.c.
+ */
+
+#ifndef XEXTOOL_SHA1_H
+#define XEXTOOL_SHA1_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA1_DIGEST_SIZE 20
+#define SHA1_BLOCK_SIZE  64
+
+typedef struct {
+    uint32_t state[5];
+    uint64_t total_len;
+    uint8_t buffer[SHA1_BLOCK_SIZE];
+    size_t buffer_len;
+} Sha1Ctx;
+
+void sha1_init(Sha1Ctx *ctx);
+void sha1_update(Sha1Ctx *ctx, const uint8_t *data, size_t len);
+void sha1_final(Sha1Ctx *ctx, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+/* One-shot digest of a buffer */
+void sha1(const uint8_t *data, size_t len, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+#endif /* XEXTOOL_SHA1_H */
@@ -0,0 +1,1552 @@
+/*
+ * libxextool - XEX file parsing library
+ *
+ * Implementation of the parsing core.  See xex.h for the API contract:
+ * no output, no heap allocation on the parse path, status codes for
+ * every failure.
+ */
+
+#define _GNU_SOURCE      /* mmap, madvise */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "xex.h"
+#include "lzx.h"
+#include "aes.h"
+
+/* Helper function to convert big-endian to host byte order (32-bit) */
+uint32_t be32_to_cpu(uint32_t val) {
+    return __builtin_bswap32(val);
+}
+
+/* Helper function to convert big-endian to host byte order (16-bit) */
+uint16_t be16_to_cpu(uint16_t val) {
+    return __builtin_bswap16(val);
+}
+
+/*
+ * Bulk big-endian to host conversion.  The plain loop over
+ * __builtin_bswap32 vectorizes (pshufb/rev32) so converting a whole
+ * optional-header table is one pass instead of a call per field.
+ */
+void be32_to_cpu_array(uint32_t *buf, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = __builtin_bswap32(buf[i]);
+    }
+}
+
+/* Get encryption type name */
+const char *get_encryption_name(uint16_t type) {
+    switch (type) {
+        case XEX_ENCRYPTION_NONE:   return "None";
+        case XEX_ENCRYPTION_NORMAL: return "Normal (Encrypted)";
+        default:                    return "Unknown";
+    }
+}
+
+/* Get compression type name */
+const char *get_compression_name(uint16_t type) {
+    switch (type) {
+        case XEX_COMPRESSION_NONE:   return "None";
+        case XEX_COMPRESSION_BASIC:  return "Basic";
+        case XEX_COMPRESSION_NORMAL: return "Normal";
+        case XEX_COMPRESSION_DELTA:  return "Delta";
+        default:                     return "Unknown";
+    }
+}
+
+/*
+ * Documented optional header keys, sorted by key so identification is
+ * a binary search over a compile-time table.  Adding coverage is one
+ * table row; the lookup cost stays logarithmic in the table size.
+ */
+typedef struct {
+    uint32_t key;
+    const char *name;
+} XexKeyName;
+
+static const XexKeyName header_key_names[] = {
+    { 0x000002FF, "RESOURCE_INFO" },
+    { 0x000003FF, "FILE_FORMAT_INFO" },
+    { 0x00000405, "BASE_REFERENCE" },
+    { 0x000005FF, "DELTA_PATCH_DESCRIPTOR" },
+    { 0x000080FF, "BOUNDING_PATH" },
+    { 0x00008105, "DEVICE_ID" },
+    { 0x00010001, "ORIGINAL_BASE_ADDRESS" },
+    { 0x00010100, "ENTRY_POINT" },
+    { 0x00010201, "IMAGE_BASE_ADDRESS" },
+    { 0x000103FF, "IMPORT_LIBRARIES" },
+    { 0x00018002, "CHECKSUM_TIMESTAMP" },
+    { 0x00018102, "ENABLED_FOR_CALLCAP" },
+    { 0x00018200, "ENABLED_FOR_FASTCAP" },
+    { 0x000183FF, "ORIGINAL_PE_NAME" },
+    { 0x000200FF, "STATIC_LIBRARIES" },
+    { 0x00020104, "TLS_INFO" },
+    { 0x00020200, "DEFAULT_STACK_SIZE" },
+    { 0x00020301, "DEFAULT_FILESYSTEM_CACHE_SIZE" },
+    { 0x00020401, "DEFAULT_HEAP_SIZE" },
+    { 0x00028002, "PAGE_HEAP_SIZE_AND_FLAGS" },
+    { 0x00030000, "SYSTEM_FLAGS" },
+    { 0x00040006, "EXECUTION_INFO" },
+    { 0x00040201, "TITLE_WORKSPACE_SIZE" },
+    { 0x00040310, "GAME_RATINGS" },
+    { 0x00040404, "LAN_KEY" },
+    { 0x000405FF, "XBOX360_LOGO" },
+    { 0x000406FF, "MULTIDISC_MEDIA_IDS" },
+    { 0x000407FF, "ALTERNATE_TITLE_IDS" },
+    { 0x00040801, "ADDITIONAL_TITLE_MEMORY" },
+    { 0x00E10402, "EXPORTS_BY_NAME" },
+};
+
+/* Name of a documented optional header key (NULL when unknown) */
+const char *xex_header_key_name(uint32_t key) {
+    size_t lo = 0;
+    size_t hi = sizeof(header_key_names) / sizeof(header_key_names[0]);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (header_key_names[mid].key == key) {
+            return header_key_names[mid].name;
+        }
+        if (header_key_names[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+/* Describe a library status code */
+const char *xex_strerror(int status) {
+    switch (status) {
+        case XEX_OK:              return "Success";
+        case XEX_ERR_IO:          return "I/O error";
+        case XEX_ERR_TRUNCATED:   return "File truncated";
+        case XEX_ERR_MAGIC:       return "Magic number mismatch";
+        case XEX_ERR_NOMEM:       return "Out of memory";
+        case XEX_ERR_UNSUPPORTED: return "Unsupported for this image";
+        case XEX_ERR_FORMAT:      return "Malformed image data";
+        default:                  return "Unknown error";
+    }
+}
+
+/* Map (or read) an entire XEX file into memory */
+int xex_view_open(const char *filename, XexView *view, int use_mmap) {
+    int fd;
+    struct stat st;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return XEX_ERR_IO;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return XEX_ERR_IO;
+    }
+
+    view->size = (size_t)st.st_size;
+    view->data = NULL;
+    view->is_mapped = 0;
+
+    if (use_mmap && view->size > 0) {
+        void *map = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            /* Header walk is sequential; let the kernel read ahead */
+            madvise(map, view->size, MADV_SEQUENTIAL);
+            view->data = map;
+            view->is_mapped = 1;
+        }
+    }
+
+    if (!view->data) {
+        /* Fallback: one bulk read into a heap buffer */
+        uint8_t *buf = malloc(view->size ? view->size : 1);
+        if (!buf) {
+            close(fd);
+            return XEX_ERR_IO;
+        }
+        size_t total = 0;
+        while (total < view->size) {
+            ssize_t n = read(fd, buf + total, view->size - total);
+            if (n <= 0) {
+                free(buf);
+                close(fd);
+                return XEX_ERR_IO;
+            }
+            total += (size_t)n;
+        }
+        view->data = buf;
+    }
+
+    close(fd);
+    return XEX_OK;
+}
+
+/* Release a view obtained from xex_view_open() */
+void xex_view_close(XexView *view) {
+    if (view->is_mapped) {
+        munmap((void *)view->data, view->size);
+    } else {
+        free((void *)view->data);
+    }
+    view->data = NULL;
+    view->size = 0;
+}
+
+/* Heap chunk appended when the fixed buffer runs out */
+struct XexArenaChunk {
+    struct XexArenaChunk *next;
+    size_t size;
+    size_t used;
+    uint8_t data[];
+};
+
+/* Minimum overflow chunk size; large requests get a chunk to themselves */
+#define XEX_ARENA_CHUNK_MIN (16 * 1024)
+
+/* Initialize an arena over a caller-provided buffer */
+void xex_arena_init(XexArena *arena, void *buf, size_t size) {
+    arena->base = buf;
+    arena->size = size;
+    arena->used = 0;
+    arena->chunks = NULL;
+}
+
+/* Bump-allocate from an arena, growing onto the heap when the fixed
+ * buffer runs out; returns NULL only when the heap is exhausted */
+void *xex_arena_alloc(XexArena *arena, size_t size) {
+    /* Keep allocations naturally aligned for the structures we store */
+    if (!arena->chunks) {
+        size_t aligned = (arena->used + 7) & ~(size_t)7;
+        if (aligned + size <= arena->size) {
+            arena->used = aligned + size;
+            return arena->base + aligned;
+        }
+    } else {
+        XexArenaChunk *chunk = arena->chunks;
+        size_t aligned = (chunk->used + 7) & ~(size_t)7;
+        if (aligned + size <= chunk->size) {
+            chunk->used = aligned + size;
+            return chunk->data + aligned;
+        }
+    }
+
+    /* Grow: chain a new heap chunk in front (old allocations stay put) */
+    size_t chunk_size = size > XEX_ARENA_CHUNK_MIN ? size : XEX_ARENA_CHUNK_MIN;
+    XexArenaChunk *chunk = malloc(sizeof(XexArenaChunk) + chunk_size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = arena->chunks;
+    chunk->size = chunk_size;
+    chunk->used = size;
+    arena->chunks = chunk;
+    return chunk->data;
+}
+
+/* Free any heap chunks the arena grew onto */
+void xex_arena_release(XexArena *arena) {
+    XexArenaChunk *chunk = arena->chunks;
+    while (chunk) {
+        XexArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+    arena->used = 0;
+}
+
+/* Parse the XEX headers out of a view into caller-provided storage */
+int xex_parse(const XexView *view, XexArena *arena, XexParsed *out) {
+    memset(out, 0, sizeof(*out));
+
+    if (view->size < sizeof(XEX2_Header)) {
+        return XEX_ERR_TRUNCATED;
+    }
+
+    const XEX2_Header *header = (const XEX2_Header *)view->data;
+    if (be32_to_cpu(header->magic) != XEX2_MAGIC) {
+        return XEX_ERR_MAGIC;
+    }
+
+    out->module_flags = be32_to_cpu(header->module_flags);
+    out->pe_offset = be32_to_cpu(header->pe_offset);
+    out->security_offset = be32_to_cpu(header->security_offset);
+
+    /* Bulk-copy the optional header table into the arena and convert
+     * it.  The count is bounded only by the bytes actually present; the
+     * arena grows to hold however many entries the image declares. */
+    uint32_t opt_count = be32_to_cpu(header->optional_header_count);
+    if (opt_count > 0) {
+        size_t opt_avail = (view->size - sizeof(XEX2_Header)) / sizeof(XexOptHeader);
+        if (opt_avail > opt_count) {
+            opt_avail = opt_count;
+        }
+
+        XexOptHeader *table = xex_arena_alloc(arena, opt_avail * sizeof(XexOptHeader));
+        if (!table) {
+            return XEX_ERR_NOMEM;
+        }
+        memcpy(table, view->data + sizeof(XEX2_Header),
+               opt_avail * sizeof(XexOptHeader));
+        be32_to_cpu_array((uint32_t *)table, opt_avail * 2);
+
+        out->opt_headers = table;
+        out->opt_count = (uint32_t)opt_avail;
+    }
+
+    /* Decode FILE_FORMAT_INFO when present */
+    const XexOptHeader *ffi_header = xex_find_header(out, XEX_HEADER_FILE_FORMAT_INFO);
+    if (ffi_header &&
+        (size_t)ffi_header->value + sizeof(FileFormatInfo) <= view->size) {
+        const FileFormatInfo *ffi =
+            (const FileFormatInfo *)(view->data + ffi_header->value);
+        out->has_file_format_info = 1;
+        out->file_format_info_offset = ffi_header->value;
+        out->info_size = be32_to_cpu(ffi->info_size);
+        out->encryption_type = be16_to_cpu(ffi->encryption_type);
+        out->compression_type = be16_to_cpu(ffi->compression_type);
+    }
+
+    return XEX_OK;
+}
+
+/* Read exactly len bytes from a (possibly non-seekable) descriptor */
+static int stream_read_full(int fd, void *buf, size_t len) {
+    uint8_t *p = buf;
+    size_t total = 0;
+    while (total < len) {
+        ssize_t n = read(fd, p + total, len - total);
+        if (n == 0) {
+            return XEX_ERR_TRUNCATED;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return XEX_ERR_IO;
+        }
+        total += (size_t)n;
+    }
+    return XEX_OK;
+}
+
+/* Discard len bytes from a descriptor without seeking */
+static int stream_skip(int fd, uint64_t len) {
+    uint8_t scratch[4096];
+    while (len > 0) {
+        size_t chunk = len < sizeof(scratch) ? (size_t)len : sizeof(scratch);
+        int status = stream_read_full(fd, scratch, chunk);
+        if (status != XEX_OK) {
+            return status;
+        }
+        len -= chunk;
+    }
+    return XEX_OK;
+}
+
+/* Parse the XEX headers from a pipe/socket in one forward pass */
+int xex_parse_stream(int fd, XexArena *arena, XexParsed *out,
+                     uint64_t *consumed) {
+    uint64_t pos = 0;
+    int status;
+
+    memset(out, 0, sizeof(*out));
+
+    XEX2_Header header;
+    status = stream_read_full(fd, &header, sizeof(header));
+    if (status != XEX_OK) {
+        goto done;
+    }
+    pos += sizeof(header);
+
+    if (be32_to_cpu(header.magic) != XEX2_MAGIC) {
+        status = XEX_ERR_MAGIC;
+        goto done;
+    }
+
+    out->module_flags = be32_to_cpu(header.module_flags);
+    out->pe_offset = be32_to_cpu(header.pe_offset);
+    out->security_offset = be32_to_cpu(header.security_offset);
+
+    /* Stream the optional header table straight into the arena.  The
+     * stream length is unknown, but the table must end before the
+     * basefile starts, which bounds a malformed count. */
+    uint32_t opt_count = be32_to_cpu(header.optional_header_count);
+    if (out->pe_offset > sizeof(header)) {
+        uint32_t opt_max = (out->pe_offset - sizeof(header)) / sizeof(XexOptHeader);
+        if (opt_count > opt_max) {
+            opt_count = opt_max;
+        }
+    }
+    if (opt_count > 0) {
+        XexOptHeader *table = xex_arena_alloc(arena,
+                                              opt_count * sizeof(XexOptHeader));
+        if (!table) {
+            status = XEX_ERR_NOMEM;
+            goto done;
+        }
+        status = stream_read_full(fd, table, opt_count * sizeof(XexOptHeader));
+        if (status != XEX_OK) {
+            goto done;
+        }
+        pos += opt_count * sizeof(XexOptHeader);
+        be32_to_cpu_array((uint32_t *)table, opt_count * 2);
+
+        out->opt_headers = table;
+        out->opt_count = opt_count;
+    }
+
+    /* Defer FILE_FORMAT_INFO until its offset streams by */
+    const XexOptHeader *ffi_header = xex_find_header(out, XEX_HEADER_FILE_FORMAT_INFO);
+    if (ffi_header) {
+        if (ffi_header->value < pos) {
+            /* A single forward pass cannot revisit consumed bytes */
+            status = XEX_ERR_FORMAT;
+            goto done;
+        }
+        status = stream_skip(fd, ffi_header->value - pos);
+        if (status != XEX_OK) {
+            goto done;
+        }
+        pos = ffi_header->value;
+
+        FileFormatInfo ffi;
+        status = stream_read_full(fd, &ffi, sizeof(ffi));
+        if (status != XEX_OK) {
+            goto done;
+        }
+        pos += sizeof(ffi);
+
+        out->has_file_format_info = 1;
+        out->file_format_info_offset = ffi_header->value;
+        out->info_size = be32_to_cpu(ffi.info_size);
+        out->encryption_type = be16_to_cpu(ffi.encryption_type);
+        out->compression_type = be16_to_cpu(ffi.compression_type);
+    }
+
+    status = XEX_OK;
+
+done:
+    if (consumed) {
+        *consumed = pos;
+    }
+    return status;
+}
+
+/* Look up an optional header by key; returns NULL when absent */
+const XexOptHeader *xex_find_header(const XexParsed *parsed, uint32_t key) {
+    for (uint32_t i = 0; i < parsed->opt_count; i++) {
+        if (parsed->opt_headers[i].key == key) {
+            return &parsed->opt_headers[i];
+        }
+    }
+    return NULL;
+}
+
+/* Uncompressed image size from the security info block (0 on failure) */
+uint32_t xex_image_size(const XexView *view, const XexParsed *parsed) {
+    /* Second field of the security info block is the image size */
+    size_t offset = (size_t)parsed->security_offset + 4;
+    if (offset + 4 > view->size) {
+        return 0;
+    }
+    uint32_t size;
+    memcpy(&size, view->data + offset, 4);
+    return be32_to_cpu(size);
+}
+
+/* Image load address from the security info block (0 on failure) */
+uint32_t xex_load_address(const XexView *view, const XexParsed *parsed) {
+    /* header_size, image_size, signature[256], unk, image_flags, then
+     * the load address */
+    size_t offset = (size_t)parsed->security_offset + 272;
+    if (offset + 4 > view->size) {
+        return 0;
+    }
+    uint32_t addr;
+    memcpy(&addr, view->data + offset, 4);
+    return be32_to_cpu(addr);
+}
+
+/* Big-endian dword at a fixed offset within the security info block */
+static uint32_t sec_u32(const uint8_t *block, size_t offset) {
+    uint32_t val;
+    memcpy(&val, block + offset, 4);
+    return be32_to_cpu(val);
+}
+
+/*
+ * Decode the security info block.  Fixed layout: header_size and
+ * image_size, a 256-byte RSA signature, then image flags, the load
+ * address, the image digest, the import table count, the media id and
+ * wrapped session key, the export table address, and the region and
+ * media flags; header_size also covers the page descriptors that
+ * follow the fixed fields.
+ */
+int xex_parse_security(const XexView *view, const XexParsed *parsed,
+                       XexSecurityInfo *out) {
+    memset(out, 0, sizeof(*out));
+
+    size_t offset = parsed->security_offset;
+    if (offset < sizeof(XEX2_Header) ||
+        offset + XEX_SECURITY_INFO_SIZE > view->size) {
+        return XEX_ERR_FORMAT;
+    }
+    const uint8_t *block = view->data + offset;
+
+    out->header_size = sec_u32(block, 0);
+    out->image_size = sec_u32(block, 4);
+    out->image_flags = sec_u32(block, 268);
+    out->load_address = sec_u32(block, 272);
+    memcpy(out->image_digest, block + 276, sizeof(out->image_digest));
+    out->import_table_count = sec_u32(block, 296);
+    out->export_table_address = sec_u32(block, 352);
+    out->game_regions = sec_u32(block, 376);
+    out->media_flags = sec_u32(block, 380);
+    return XEX_OK;
+}
+
+/* Accept/reject gate over a decoded security info block */
+int xex_security_validate(const XexView *view, const XexParsed *parsed,
+                          const XexSecurityInfo *sec) {
+    /* The block, page descriptors included, must fit the file and
+     * stay inside the header region before the basefile */
+    uint64_t block_end = (uint64_t)parsed->security_offset + sec->header_size;
+    if (sec->header_size < XEX_SECURITY_INFO_SIZE || block_end > view->size) {
+        return XEX_ERR_FORMAT;
+    }
+    if ((size_t)parsed->pe_offset < view->size &&
+        block_end > parsed->pe_offset) {
+        return XEX_ERR_FORMAT;
+    }
+
+    /* The image must describe a page-aligned mapping that does not
+     * wrap the 32-bit address space */
+    if (sec->image_size == 0 || (sec->image_size & 0xFFF) != 0) {
+        return XEX_ERR_FORMAT;
+    }
+    if (sec->load_address == 0 || (sec->load_address & 0xFFF) != 0 ||
+        (uint64_t)sec->load_address + sec->image_size > 0x100000000ULL) {
+        return XEX_ERR_FORMAT;
+    }
+    return XEX_OK;
+}
+
+/*
+ * ---- PE basefile headers ----
+ *
+ * PE structures are little-endian, unlike the XEX headers around them.
+ */
+
+/* Read a little-endian 32-bit field at offset (bounds already checked) */
+static uint32_t le32_at(const uint8_t *base, size_t offset) {
+    uint32_t val;
+    memcpy(&val, base + offset, 4);
+    return val;
+}
+
+/* Read a little-endian 16-bit field at offset (bounds already checked) */
+static uint16_t le16_at(const uint8_t *base, size_t offset) {
+    uint16_t val;
+    memcpy(&val, base + offset, 2);
+    return val;
+}
+
+/* Decode the embedded PE headers and section table into the arena */
+int xex_parse_pe(const XexView *view, const XexParsed *parsed,
+                 XexArena *arena, XexPeInfo *out) {
+    memset(out, 0, sizeof(*out));
+
+    /* Only a stored basefile can be read in place */
+    if (parsed->has_file_format_info &&
+        (parsed->encryption_type != XEX_ENCRYPTION_NONE ||
+         parsed->compression_type != XEX_COMPRESSION_NONE)) {
+        return XEX_ERR_UNSUPPORTED;
+    }
+
+    if (parsed->pe_offset >= view->size ||
+        view->size - parsed->pe_offset < 0x40) {
+        return XEX_ERR_TRUNCATED;
+    }
+    const uint8_t *pe = view->data + parsed->pe_offset;
+    size_t pe_size = view->size - parsed->pe_offset;
+
+    /* DOS header: "MZ" plus e_lfanew pointing at the PE signature */
+    if (pe[0] != 'M' || pe[1] != 'Z') {
+        return XEX_ERR_FORMAT;
+    }
+    size_t nt_offset = le32_at(pe, 0x3C);
+    if (nt_offset + 24 > pe_size || le32_at(pe, nt_offset) != 0x00004550) {
+        return XEX_ERR_FORMAT;
+    }
+
+    /* COFF file header follows the "PE\0\0" signature */
+    size_t coff = nt_offset + 4;
+    out->machine = le16_at(pe, coff);
+    out->section_count = le16_at(pe, coff + 2);
+    out->timestamp = le32_at(pe, coff + 4);
+    uint16_t opt_size = le16_at(pe, coff + 16);
+    if (out->section_count > XEX_PE_MAX_SECTIONS) {
+        return XEX_ERR_FORMAT;
+    }
+
+    /* PE32 optional header: entry point RVA and preferred image base */
+    size_t opt = coff + 20;
+    if (opt_size >= 32 && opt + opt_size <= pe_size &&
+        le16_at(pe, opt) == 0x010B) {
+        out->entry_point_rva = le32_at(pe, opt + 16);
+        out->image_base = le32_at(pe, opt + 28);
+    }
+
+    /* Section table: 40-byte entries after the optional header */
+    size_t table = opt + opt_size;
+    if (table + (size_t)out->section_count * 40 > pe_size) {
+        return XEX_ERR_TRUNCATED;
+    }
+
+    XexPeSection *sections =
+        xex_arena_alloc(arena, out->section_count * sizeof(XexPeSection));
+    if (!sections) {
+        return XEX_ERR_NOMEM;
+    }
+
+    for (uint32_t i = 0; i < out->section_count; i++) {
+        const uint8_t *entry = pe + table + i * 40;
+        memcpy(sections[i].name, entry, 8);
+        sections[i].name[8] = '\0';
+        sections[i].virtual_size = le32_at(entry, 8);
+        sections[i].virtual_address = le32_at(entry, 12);
+        sections[i].raw_size = le32_at(entry, 16);
+        sections[i].raw_offset = le32_at(entry, 20);
+        sections[i].characteristics = le32_at(entry, 36);
+    }
+    out->sections = sections;
+
+    return XEX_OK;
+}
+
+/* FNV-1a hash of a string, for the import name index */
+static uint32_t hash_string(const char *s) {
+    uint32_t hash = 2166136261u;
+    for (; *s; s++) {
+        hash ^= (unsigned char)*s;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Round up to the next power of two (minimum 8) */
+static uint32_t round_up_pow2(uint32_t n) {
+    uint32_t p = 8;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+/* Decode the import libraries block and build the name index */
+int xex_parse_imports(const XexView *view, const XexParsed *parsed,
+                      XexArena *arena, XexImportTable *table) {
+    memset(table, 0, sizeof(*table));
+
+    const XexOptHeader *opt = xex_find_header(parsed, XEX_HEADER_IMPORT_LIBRARIES);
+    if (!opt) {
+        return XEX_ERR_UNSUPPORTED;
+    }
+
+    /* Block layout: total size, string table (size, count, packed
+     * names), then one variable-length record per library */
+    size_t base = opt->value;
+    if (base + 12 > view->size) {
+        return XEX_ERR_FORMAT;
+    }
+    uint32_t block_size, st_size, st_count;
+    memcpy(&block_size, view->data + base, 4);
+    memcpy(&st_size, view->data + base + 4, 4);
+    memcpy(&st_count, view->data + base + 8, 4);
+    block_size = be32_to_cpu(block_size);
+    st_size = be32_to_cpu(st_size);
+    st_count = be32_to_cpu(st_count);
+
+    if (base + block_size > view->size || 12 + (size_t)st_size > block_size ||
+        st_count > 256) {
+        return XEX_ERR_FORMAT;
+    }
+
+    /* Walk the packed, 4-byte-aligned name strings */
+    const char *names[256];
+    const char *st_data = (const char *)(view->data + base + 12);
+    size_t st_pos = 0;
+    for (uint32_t i = 0; i < st_count; i++) {
+        if (st_pos >= st_size) {
+            return XEX_ERR_FORMAT;
+        }
+        names[i] = st_data + st_pos;
+        size_t len = strnlen(st_data + st_pos, st_size - st_pos);
+        if (len == st_size - st_pos) {
+            /* No terminator inside the table: later unbounded reads
+             * of the name would run past it */
+            return XEX_ERR_FORMAT;
+        }
+        st_pos += (len + 4) & ~(size_t)3;
+    }
+
+    XexImportLibrary *libraries =
+        xex_arena_alloc(arena, st_count * sizeof(XexImportLibrary));
+    if (!libraries) {
+        return XEX_ERR_NOMEM;
+    }
+
+    /* Library records follow the string table */
+    size_t pos = base + 12 + st_size;
+    size_t end = base + block_size;
+    uint32_t count = 0;
+
+    while (pos + 40 <= end && count < st_count) {
+        const uint8_t *rec = view->data + pos;
+        uint32_t rec_size, id, version, version_min;
+        uint16_t name_index, record_count;
+        memcpy(&rec_size, rec, 4);
+        memcpy(&id, rec + 24, 4);
+        memcpy(&version, rec + 28, 4);
+        memcpy(&version_min, rec + 32, 4);
+        memcpy(&name_index, rec + 36, 2);
+        memcpy(&record_count, rec + 38, 2);
+        rec_size = be32_to_cpu(rec_size);
+        name_index = be16_to_cpu(name_index);
+        record_count = be16_to_cpu(record_count);
+
+        if (rec_size < 40 || pos + rec_size > end ||
+            40 + (size_t)record_count * 4 > rec_size || name_index >= st_count) {
+            return XEX_ERR_FORMAT;
+        }
+
+        uint32_t *records = xex_arena_alloc(arena, record_count * 4);
+        if (!records) {
+            return XEX_ERR_NOMEM;
+        }
+        memcpy(records, rec + 40, (size_t)record_count * 4);
+        be32_to_cpu_array(records, record_count);
+
+        libraries[count].name = names[name_index];
+        libraries[count].id = be32_to_cpu(id);
+        libraries[count].version = be32_to_cpu(version);
+        libraries[count].version_min = be32_to_cpu(version_min);
+        libraries[count].record_count = record_count;
+        libraries[count].records = records;
+        count++;
+
+        pos += rec_size;
+    }
+
+    table->libraries = libraries;
+    table->library_count = count;
+
+    /* Name hash index: open addressing, power-of-two buckets */
+    table->name_buckets = round_up_pow2(count * 2);
+    table->name_index =
+        xex_arena_alloc(arena, table->name_buckets * sizeof(int32_t));
+    if (!table->name_index) {
+        return XEX_ERR_NOMEM;
+    }
+    memset(table->name_index, 0xFF, table->name_buckets * sizeof(int32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t slot = hash_string(libraries[i].name) & (table->name_buckets - 1);
+        while (table->name_index[slot] >= 0) {
+            slot = (slot + 1) & (table->name_buckets - 1);
+        }
+        table->name_index[slot] = (int32_t)i;
+    }
+
+    return XEX_OK;
+}
+
+/* O(1) lookup of a library by name */
+const XexImportLibrary *xex_import_find_library(const XexImportTable *table,
+                                                const char *name) {
+    if (table->name_buckets == 0) {
+        return NULL;
+    }
+    uint32_t slot = hash_string(name) & (table->name_buckets - 1);
+    while (table->name_index[slot] >= 0) {
+        const XexImportLibrary *lib = &table->libraries[table->name_index[slot]];
+        if (strcmp(lib->name, name) == 0) {
+            return lib;
+        }
+        slot = (slot + 1) & (table->name_buckets - 1);
+    }
+    return NULL;
+}
+
+/* Resolve import ordinals from the decrypted basefile image */
+int xex_import_resolve(XexImportTable *table, XexArena *arena,
+                       const uint8_t *image, size_t image_size,
+                       uint32_t load_address) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < table->library_count; i++) {
+        total += table->libraries[i].record_count;
+    }
+
+    XexImportSymbol *symbols =
+        xex_arena_alloc(arena, total * sizeof(XexImportSymbol));
+    if (!symbols) {
+        return XEX_ERR_NOMEM;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < table->library_count; i++) {
+        const XexImportLibrary *lib = &table->libraries[i];
+        for (uint32_t r = 0; r < lib->record_count; r++) {
+            uint32_t address = lib->records[r];
+            if (address < load_address ||
+                (size_t)(address - load_address) + 4 > image_size) {
+                continue;
+            }
+            /* Each slot holds (type << 24) | (library << 16) | ordinal */
+            uint32_t value;
+            memcpy(&value, image + (address - load_address), 4);
+            value = be32_to_cpu(value);
+
+            symbols[count].library_index = i;
+            symbols[count].ordinal = value & 0xFFFF;
+            symbols[count].type = value >> 24;
+            symbols[count].address = address;
+            count++;
+        }
+    }
+
+    table->symbols = symbols;
+    table->symbol_count = count;
+
+    /* Ordinal hash index keyed by (library, ordinal) */
+    table->symbol_buckets = round_up_pow2(count * 2);
+    table->symbol_index =
+        xex_arena_alloc(arena, table->symbol_buckets * sizeof(int32_t));
+    if (!table->symbol_index) {
+        return XEX_ERR_NOMEM;
+    }
+    memset(table->symbol_index, 0xFF, table->symbol_buckets * sizeof(int32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t key = (symbols[i].library_index << 16) | symbols[i].ordinal;
+        uint32_t slot = (key * 2654435761u) & (table->symbol_buckets - 1);
+        while (table->symbol_index[slot] >= 0) {
+            slot = (slot + 1) & (table->symbol_buckets - 1);
+        }
+        table->symbol_index[slot] = (int32_t)i;
+    }
+
+    return XEX_OK;
+}
+
+/* O(1) lookup of a resolved import by library index and ordinal */
+const XexImportSymbol *xex_import_find_ordinal(const XexImportTable *table,
+                                               uint32_t library_index,
+                                               uint32_t ordinal) {
+    if (table->symbol_buckets == 0) {
+        return NULL;
+    }
+    uint32_t key = (library_index << 16) | ordinal;
+    uint32_t slot = (key * 2654435761u) & (table->symbol_buckets - 1);
+    while (table->symbol_index[slot] >= 0) {
+        const XexImportSymbol *sym = &table->symbols[table->symbol_index[slot]];
+        if (sym->library_index == library_index && sym->ordinal == ordinal) {
+            return sym;
+        }
+        slot = (slot + 1) & (table->symbol_buckets - 1);
+    }
+    return NULL;
+}
+
+/* Write all of buf to fd, retrying short writes */
+static int write_all(int fd, const uint8_t *buf, size_t len) {
+    size_t total = 0;
+    while (total < len) {
+        ssize_t n = write(fd, buf + total, len - total);
+        if (n <= 0) {
+            return XEX_ERR_IO;
+        }
+        total += (size_t)n;
+    }
+    return XEX_OK;
+}
+
+/* Stream a Basic-compressed basefile: data blocks interleaved with zeros */
+static int extract_basic(const XexView *view, const XexParsed *parsed,
+                         const uint8_t *payload, size_t payload_size, int fd) {
+    /* The block array follows the fixed FILE_FORMAT_INFO fields */
+    size_t blocks_offset = (size_t)parsed->file_format_info_offset +
+                           sizeof(FileFormatInfo);
+    if (parsed->info_size < sizeof(FileFormatInfo)) {
+        return XEX_ERR_FORMAT;
+    }
+    size_t block_count = (parsed->info_size - sizeof(FileFormatInfo)) /
+                         sizeof(XexBasicBlock);
+    if (blocks_offset + block_count * sizeof(XexBasicBlock) > view->size) {
+        return XEX_ERR_FORMAT;
+    }
+    const XexBasicBlock *blocks =
+        (const XexBasicBlock *)(view->data + blocks_offset);
+
+    static const uint8_t zeros[65536];
+    size_t in_pos = 0;
+
+    for (size_t i = 0; i < block_count; i++) {
+        size_t data_size = be32_to_cpu(blocks[i].data_size);
+        size_t zero_size = be32_to_cpu(blocks[i].zero_size);
+
+        if (in_pos + data_size > payload_size) {
+            return XEX_ERR_FORMAT;
+        }
+        int ret = write_all(fd, payload + in_pos, data_size);
+        if (ret != XEX_OK) {
+            return ret;
+        }
+        in_pos += data_size;
+
+        while (zero_size > 0) {
+            size_t n = zero_size < sizeof(zeros) ? zero_size : sizeof(zeros);
+            ret = write_all(fd, zeros, n);
+            if (ret != XEX_OK) {
+                return ret;
+            }
+            zero_size -= n;
+        }
+    }
+    return XEX_OK;
+}
+
+/* Decompress a Normal (LZX) basefile block chain into a caller buffer */
+static int extract_normal_image(const XexView *view, const XexParsed *parsed,
+                                const uint8_t *payload, size_t payload_size,
+                                uint8_t *image, uint32_t image_size) {
+    /* The normal-compression descriptor follows the fixed FFI fields */
+    size_t info_offset = (size_t)parsed->file_format_info_offset +
+                         sizeof(FileFormatInfo);
+    if (info_offset + sizeof(XexNormalCompressionInfo) > view->size) {
+        return XEX_ERR_FORMAT;
+    }
+    const XexNormalCompressionInfo *info =
+        (const XexNormalCompressionInfo *)(view->data + info_offset);
+    uint32_t window_size = be32_to_cpu(info->window_size);
+    uint32_t block_size = be32_to_cpu(info->block_size);
+
+    /*
+     * Gather the LZX chunks out of the block chain.  Each block starts
+     * with the next block's size and hash, followed by 16-bit
+     * length-prefixed chunks (a zero length ends the block).
+     */
+    uint8_t *compressed = malloc(payload_size);
+    if (!compressed) {
+        return XEX_ERR_NOMEM;
+    }
+    size_t compressed_len = 0;
+    size_t block_start = 0;
+    int ret = XEX_OK;
+
+    while (block_size > 0) {
+        if (block_start + block_size > payload_size || block_size < 24) {
+            ret = XEX_ERR_FORMAT;
+            break;
+        }
+        const uint8_t *block = payload + block_start;
+        uint32_t next_size;
+        memcpy(&next_size, block, 4);
+        next_size = be32_to_cpu(next_size);
+
+        size_t pos = 24;    /* Skip next-block size and hash */
+        while (pos + 2 <= block_size) {
+            size_t chunk = ((size_t)block[pos] << 8) | block[pos + 1];
+            pos += 2;
+            if (chunk == 0) {
+                break;
+            }
+            if (pos + chunk > block_size) {
+                ret = XEX_ERR_FORMAT;
+                break;
+            }
+            memcpy(compressed + compressed_len, block + pos, chunk);
+            compressed_len += chunk;
+            pos += chunk;
+        }
+        if (ret != XEX_OK) {
+            break;
+        }
+
+        block_start += block_size;
+        block_size = next_size;
+    }
+
+    if (ret == XEX_OK &&
+        lzx_decompress(compressed, compressed_len,
+                       image, image_size, window_size) != LZX_OK) {
+        ret = XEX_ERR_FORMAT;
+    }
+
+    free(compressed);
+    return ret;
+}
+
+/* Decompress a Normal (LZX) basefile through a temporary image buffer */
+static int extract_normal(const XexView *view, const XexParsed *parsed,
+                          const uint8_t *payload, size_t payload_size, int fd) {
+    uint32_t image_size = xex_image_size(view, parsed);
+    if (image_size == 0) {
+        return XEX_ERR_FORMAT;
+    }
+
+    uint8_t *image = malloc(image_size);
+    if (!image) {
+        return XEX_ERR_NOMEM;
+    }
+    int ret = extract_normal_image(view, parsed, payload, payload_size,
+                                   image, image_size);
+    if (ret == XEX_OK) {
+        ret = write_all(fd, image, image_size);
+    }
+    free(image);
+    return ret;
+}
+
+/*
+ * Key-encryption keys used to unwrap the per-image session key stored
+ * in the security info block.  Retail images use the well-known retail
+ * key, devkit images an all-zero key; both are tried.
+ */
+static const uint8_t xex_retail_kek[16] = {
+    0x20, 0xB1, 0x85, 0xA5, 0x9D, 0x28, 0xFD, 0xC3,
+    0x40, 0x58, 0x3F, 0xBB, 0x08, 0x96, 0xBF, 0x91
+};
+static const uint8_t xex_devkit_kek[16] = { 0 };
+
+/* Offset of the wrapped session key within the security info block */
+#define XEX_SECURITY_AES_KEY_OFFSET 336
+
+/* Unwrap the session key from the security info block */
+static int xex_session_key(const XexView *view, const XexParsed *parsed,
+                           const uint8_t kek[16], uint8_t out[16]) {
+    size_t offset = (size_t)parsed->security_offset + XEX_SECURITY_AES_KEY_OFFSET;
+    if (offset + 16 > view->size) {
+        return XEX_ERR_FORMAT;
+    }
+    aes128_decrypt_ecb(kek, view->data + offset, out);
+    return XEX_OK;
+}
+
+/* Dispatch a (possibly decrypted) payload to the right decompressor */
+static int extract_payload(const XexView *view, const XexParsed *parsed,
+                           const uint8_t *payload, size_t payload_size, int fd) {
+    switch (parsed->compression_type) {
+        case XEX_COMPRESSION_NONE:
+            return write_all(fd, payload, payload_size);
+        case XEX_COMPRESSION_BASIC:
+            return extract_basic(view, parsed, payload, payload_size, fd);
+        case XEX_COMPRESSION_NORMAL:
+            return extract_normal(view, parsed, payload, payload_size, fd);
+        default:
+            return XEX_ERR_UNSUPPORTED;
+    }
+}
+
+/* Final basefile size for a payload, known before any byte is written */
+static int extract_output_size(const XexView *view, const XexParsed *parsed,
+                               size_t payload_size, size_t *out_size) {
+    switch (parsed->compression_type) {
+        case XEX_COMPRESSION_NONE:
+            *out_size = payload_size;
+            return XEX_OK;
+        case XEX_COMPRESSION_BASIC: {
+            /* Sum the data and zero runs from the block descriptors */
+            size_t blocks_offset = (size_t)parsed->file_format_info_offset +
+                                   sizeof(FileFormatInfo);
+            if (parsed->info_size < sizeof(FileFormatInfo)) {
+                return XEX_ERR_FORMAT;
+            }
+            size_t block_count = (parsed->info_size - sizeof(FileFormatInfo)) /
+                                 sizeof(XexBasicBlock);
+            if (blocks_offset + block_count * sizeof(XexBasicBlock) >
+                view->size) {
+                return XEX_ERR_FORMAT;
+            }
+            const XexBasicBlock *blocks =
+                (const XexBasicBlock *)(view->data + blocks_offset);
+            size_t total = 0;
+            for (size_t i = 0; i < block_count; i++) {
+                total += (size_t)be32_to_cpu(blocks[i].data_size) +
+                         be32_to_cpu(blocks[i].zero_size);
+            }
+            *out_size = total;
+            return XEX_OK;
+        }
+        case XEX_COMPRESSION_NORMAL: {
+            uint32_t image_size = xex_image_size(view, parsed);
+            if (image_size == 0) {
+                return XEX_ERR_FORMAT;
+            }
+            *out_size = image_size;
+            return XEX_OK;
+        }
+        default:
+            return XEX_ERR_UNSUPPORTED;
+    }
+}
+
+/*
+ * Pre-size the output file and map it writable so the decompression
+ * stages can produce the basefile directly in the page cache: no
+ * intermediate output buffer, no per-block write calls, and the kernel
+ * coalesces the dirty pages into one writeback at munmap/close.
+ * MADV_HUGEPAGE asks for transparent hugepages behind the mapping,
+ * which cuts fault counts on GB-scale images.  Returns NULL when the
+ * filesystem cannot back a shared writable mapping; callers fall back
+ * to the write path.
+ */
+static uint8_t *extract_map_create(int fd, size_t size) {
+    if (size == 0 || ftruncate(fd, (off_t)size) != 0) {
+        return NULL;
+    }
+    uint8_t *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        fd, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(map, size, MADV_HUGEPAGE);
+#endif
+    return map;
+}
+
+/* Basic decompression straight into the mapping.  Zero runs are
+ * skipped entirely: ftruncate already guarantees those pages read back
+ * as zeros, so sparse images never fault them in. */
+static int extract_basic_mapped(const XexView *view, const XexParsed *parsed,
+                                const uint8_t *payload, size_t payload_size,
+                                uint8_t *map, size_t map_size) {
+    size_t blocks_offset = (size_t)parsed->file_format_info_offset +
+                           sizeof(FileFormatInfo);
+    if (parsed->info_size < sizeof(FileFormatInfo)) {
+        return XEX_ERR_FORMAT;
+    }
+    size_t block_count = (parsed->info_size - sizeof(FileFormatInfo)) /
+                         sizeof(XexBasicBlock);
+    if (blocks_offset + block_count * sizeof(XexBasicBlock) > view->size) {
+        return XEX_ERR_FORMAT;
+    }
+    const XexBasicBlock *blocks =
+        (const XexBasicBlock *)(view->data + blocks_offset);
+
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    for (size_t i = 0; i < block_count; i++) {
+        size_t data_size = be32_to_cpu(blocks[i].data_size);
+        size_t zero_size = be32_to_cpu(blocks[i].zero_size);
+        if (in_pos + data_size > payload_size ||
+            out_pos + data_size + zero_size > map_size) {
+            return XEX_ERR_FORMAT;
+        }
+        memcpy(map + out_pos, payload + in_pos, data_size);
+        in_pos += data_size;
+        out_pos += data_size + zero_size;
+    }
+    return XEX_OK;
+}
+
+/* Dispatch a (possibly decrypted) payload into a writable mapping */
+static int extract_payload_mapped(const XexView *view, const XexParsed *parsed,
+                                  const uint8_t *payload, size_t payload_size,
+                                  uint8_t *map, size_t map_size) {
+    switch (parsed->compression_type) {
+        case XEX_COMPRESSION_NONE:
+            if (payload_size > map_size) {
+                return XEX_ERR_FORMAT;
+            }
+            memcpy(map, payload, payload_size);
+            return XEX_OK;
+        case XEX_COMPRESSION_BASIC:
+            return extract_basic_mapped(view, parsed, payload, payload_size,
+                                        map, map_size);
+        case XEX_COMPRESSION_NORMAL:
+            return extract_normal_image(view, parsed, payload, payload_size,
+                                        map, (uint32_t)map_size);
+        default:
+            return XEX_ERR_UNSUPPORTED;
+    }
+}
+
+/* Build the block index; works for NONE and BASIC compression */
+int xex_block_index_build(const XexView *view, const XexParsed *parsed,
+                          XexArena *arena, XexBlockIndex *index) {
+    memset(index, 0, sizeof(*index));
+
+    if (!parsed->has_file_format_info ||
+        parsed->encryption_type != XEX_ENCRYPTION_NONE) {
+        return XEX_ERR_UNSUPPORTED;
+    }
+    if ((size_t)parsed->pe_offset >= view->size) {
+        return XEX_ERR_FORMAT;
+    }
+    size_t payload_size = view->size - parsed->pe_offset;
+
+    if (parsed->compression_type == XEX_COMPRESSION_NONE) {
+        /* One synthetic block covering the whole stored payload */
+        XexBlockMapEntry *entry = xex_arena_alloc(arena, sizeof(*entry));
+        if (!entry) {
+            return XEX_ERR_NOMEM;
+        }
+        entry->uncompressed_offset = 0;
+        entry->payload_offset = 0;
+        entry->data_size = (uint32_t)payload_size;
+        entry->zero_size = 0;
+        index->entry_count = 1;
+        index->entries = entry;
+        index->total_size = (uint32_t)payload_size;
+        return XEX_OK;
+    }
+
+    if (parsed->compression_type != XEX_COMPRESSION_BASIC) {
+        /* LZX keeps window state across blocks; no mid-stream entry */
+        return XEX_ERR_UNSUPPORTED;
+    }
+
+    /* Walk the Basic block descriptors once, accumulating offsets */
+    size_t blocks_offset = (size_t)parsed->file_format_info_offset +
+                           sizeof(FileFormatInfo);
+    if (parsed->info_size < sizeof(FileFormatInfo)) {
+        return XEX_ERR_FORMAT;
+    }
+    size_t block_count = (parsed->info_size - sizeof(FileFormatInfo)) /
+                         sizeof(XexBasicBlock);
+    if (blocks_offset + block_count * sizeof(XexBasicBlock) > view->size) {
+        return XEX_ERR_FORMAT;
+    }
+    const XexBasicBlock *blocks =
+        (const XexBasicBlock *)(view->data + blocks_offset);
+
+    XexBlockMapEntry *entries =
+        xex_arena_alloc(arena, block_count * sizeof(XexBlockMapEntry));
+    if (!entries) {
+        return XEX_ERR_NOMEM;
+    }
+
+    uint32_t out_pos = 0;
+    uint32_t in_pos = 0;
+    for (size_t i = 0; i < block_count; i++) {
+        uint32_t data_size = be32_to_cpu(blocks[i].data_size);
+        uint32_t zero_size = be32_to_cpu(blocks[i].zero_size);
+        if ((size_t)in_pos + data_size > payload_size) {
+            return XEX_ERR_FORMAT;
+        }
+        entries[i].uncompressed_offset = out_pos;
+        entries[i].payload_offset = in_pos;
+        entries[i].data_size = data_size;
+        entries[i].zero_size = zero_size;
+        out_pos += data_size + zero_size;
+        in_pos += data_size;
+    }
+
+    index->entry_count = (uint32_t)block_count;
+    index->entries = entries;
+    index->total_size = out_pos;
+    return XEX_OK;
+}
+
+/* Read len uncompressed bytes at offset, touching only covering blocks */
+int xex_read_at(const XexView *view, const XexParsed *parsed,
+                const XexBlockIndex *index, uint32_t offset,
+                uint8_t *buf, size_t len) {
+    if (index->entry_count == 0 ||
+        (uint64_t)offset + len > index->total_size) {
+        return XEX_ERR_FORMAT;
+    }
+
+    /* Binary search for the block containing offset */
+    uint32_t lo = 0, hi = index->entry_count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (index->entries[mid].uncompressed_offset <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    const uint8_t *payload = view->data + parsed->pe_offset;
+    size_t remaining = len;
+
+    for (uint32_t i = lo; remaining > 0 && i < index->entry_count; i++) {
+        const XexBlockMapEntry *entry = &index->entries[i];
+        uint32_t block_size = entry->data_size + entry->zero_size;
+        uint32_t skip = offset - entry->uncompressed_offset;
+
+        while (skip < block_size && remaining > 0) {
+            size_t n;
+            if (skip < entry->data_size) {
+                /* Stored bytes straight out of the payload */
+                n = entry->data_size - skip;
+                if (n > remaining) {
+                    n = remaining;
+                }
+                memcpy(buf, payload + entry->payload_offset + skip, n);
+            } else {
+                /* Zero-fill tail of the block */
+                n = block_size - skip;
+                if (n > remaining) {
+                    n = remaining;
+                }
+                memset(buf, 0, n);
+            }
+            buf += n;
+            skip += (uint32_t)n;
+            offset += (uint32_t)n;
+            remaining -= n;
+        }
+    }
+
+    return remaining == 0 ? XEX_OK : XEX_ERR_FORMAT;
+}
+
+/* Apply a Delta-compressed patch against a base image */
+int xex_apply_delta(const XexView *base, const XexView *patch,
+                    const XexParsed *patch_parsed, const char *out_path) {
+    if (!patch_parsed->has_file_format_info ||
+        patch_parsed->compression_type != XEX_COMPRESSION_DELTA) {
+        return XEX_ERR_UNSUPPORTED;
+    }
+    /* Encrypted patches would need the decrypt pass first */
+    if (patch_parsed->encryption_type != XEX_ENCRYPTION_NONE) {
+        return XEX_ERR_UNSUPPORTED;
+    }
+    if ((size_t)patch_parsed->pe_offset >= patch->size) {
+        return XEX_ERR_FORMAT;
+    }
+
+    const uint8_t *payload = patch->data + patch_parsed->pe_offset;
+    size_t payload_size = patch->size - patch_parsed->pe_offset;
+
+    int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return XEX_ERR_IO;
+    }
+
+    /*
+     * Stream the record chain: copy a base range, then the literal
+     * bytes that follow the record header.  Both sources are mmap'd,
+     * so nothing is staged in intermediate buffers.
+     */
+    size_t pos = 0;
+    int ret = XEX_OK;
+
+    while (pos < payload_size) {
+        if (pos + sizeof(XexDeltaRecord) > payload_size) {
+            ret = XEX_ERR_FORMAT;
+            break;
+        }
+        XexDeltaRecord rec;
+        memcpy(&rec, payload + pos, sizeof(rec));
+        rec.base_offset = be32_to_cpu(rec.base_offset);
+        rec.base_size = be32_to_cpu(rec.base_size);
+        rec.data_size = be32_to_cpu(rec.data_size);
+        pos += sizeof(XexDeltaRecord);
+
+        if ((size_t)rec.base_offset + rec.base_size > base->size ||
+            pos + rec.data_size > payload_size) {
+            ret = XEX_ERR_FORMAT;
+            break;
+        }
+
+        ret = write_all(fd, base->data + rec.base_offset, rec.base_size);
+        if (ret != XEX_OK) {
+            break;
+        }
+        ret = write_all(fd, payload + pos, rec.data_size);
+        if (ret != XEX_OK) {
+            break;
+        }
+        pos += rec.data_size;
+    }
+
+    close(fd);
+    if (ret != XEX_OK) {
+        unlink(out_path);
+    }
+    return ret;
+}
+
+/*
+ * Zero-copy extraction for stored basefiles.  When the image is neither
+ * encrypted nor compressed the basefile is the literal byte range from
+ * pe_offset to end-of-file, so the kernel can move it with
+ * copy_file_range (sendfile when that is unavailable) without the bytes
+ * ever visiting a userspace buffer.
+ */
+int xex_extract_basefile_zerocopy(const char *in_path,
+                                  const XexParsed *parsed,
+                                  const char *out_path) {
+    if (!parsed->has_file_format_info ||
+        parsed->encryption_type != XEX_ENCRYPTION_NONE ||
+        parsed->compression_type != XEX_COMPRESSION_NONE) {
+        return XEX_ERR_UNSUPPORTED;
+    }
+
+    int in_fd = open(in_path, O_RDONLY);
+    if (in_fd < 0) {
+        return XEX_ERR_IO;
+    }
+
+    struct stat st;
+    if (fstat(in_fd, &st) != 0 ||
+        (off_t)parsed->pe_offset >= st.st_size) {
+        close(in_fd);
+        return XEX_ERR_FORMAT;
+    }
+
+    int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        close(in_fd);
+        return XEX_ERR_IO;
+    }
+
+    off_t offset = (off_t)parsed->pe_offset;
+    size_t remaining = (size_t)(st.st_size - offset);
+    int ret = XEX_OK;
+
+    while (remaining > 0) {
+        ssize_t n = copy_file_range(in_fd, &offset, out_fd, NULL,
+                                    remaining, 0);
+        if (n < 0 && (errno == EINVAL || errno == ENOSYS ||
+                      errno == EXDEV)) {
+            /* Filesystem without copy_file_range: sendfile still keeps
+             * the copy inside the kernel */
+            n = sendfile(out_fd, in_fd, &offset, remaining);
+        }
+        if (n <= 0) {
+            ret = XEX_ERR_IO;
+            break;
+        }
+        remaining -= (size_t)n;
+    }
+
+    close(in_fd);
+    close(out_fd);
+    if (ret != XEX_OK) {
+        unlink(out_path);
+    }
+    return ret;
+}
+
+/* Extract the PE basefile to out_path */
+int xex_extract_basefile(const XexView *view, const XexParsed *parsed,
+                         const char *out_path) {
+    if (!parsed->has_file_format_info) {
+        return XEX_ERR_UNSUPPORTED;
+    }
+    if ((size_t)parsed->pe_offset >= view->size) {
+        return XEX_ERR_FORMAT;
+    }
+
+    const uint8_t *payload = view->data + parsed->pe_offset;
+    size_t payload_size = view->size - parsed->pe_offset;
+
+    int fd = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return XEX_ERR_IO;
+    }
+
+    /*
+     * Preferred output path: the final size is computable up front, so
+     * pre-size the file and let the stages write decompressed bytes
+     * directly into a writable mapping.  When the mapping cannot be
+     * established the per-block write path below still works.
+     */
+    size_t out_size = 0;
+    uint8_t *out_map = NULL;
+    if (extract_output_size(view, parsed, payload_size, &out_size) == XEX_OK) {
+        out_map = extract_map_create(fd, out_size);
+        if (!out_map && ftruncate(fd, 0) != 0) {
+            close(fd);
+            unlink(out_path);
+            return XEX_ERR_IO;
+        }
+    }
+
+    int ret;
+    if (parsed->encryption_type == XEX_ENCRYPTION_NONE) {
+        if (out_map) {
+            ret = extract_payload_mapped(view, parsed, payload, payload_size,
+                                         out_map, out_size);
+        } else {
+            ret = extract_payload(view, parsed, payload, payload_size, fd);
+        }
+    } else if (parsed->encryption_type == XEX_ENCRYPTION_NORMAL) {
+        /*
+         * Decrypt the payload in one streaming CBC pass (AES-NI when
+         * available), then feed it straight to the decompressor.  The
+         * retail key is tried first, the devkit key on mismatch.
+         */
+        uint8_t *decrypted = malloc(payload_size);
+        if (!decrypted) {
+            close(fd);
+            unlink(out_path);
+            return XEX_ERR_NOMEM;
+        }
+
+        static const uint8_t zero_iv[16] = { 0 };
+        const uint8_t *keks[2] = { xex_retail_kek, xex_devkit_kek };
+        ret = XEX_ERR_FORMAT;
+
+        for (int k = 0; k < 2; k++) {
+            uint8_t session_key[16];
+            if (xex_session_key(view, parsed, keks[k], session_key) != XEX_OK) {
+                break;
+            }
+            aes128_decrypt_cbc(session_key, zero_iv, payload, decrypted,
+                               payload_size);
+
+            /* Uncompressed/Basic payloads start with the PE signature */
+            if (parsed->compression_type != XEX_COMPRESSION_NORMAL &&
+                !(payload_size >= 2 &&
+                  decrypted[0] == 'M' && decrypted[1] == 'Z')) {
+                continue;
+            }
+
+            if (out_map) {
+                /* The mapping is reused across key attempts: every
+                 * stored byte is rewritten and zero runs stay zero */
+                ret = extract_payload_mapped(view, parsed, decrypted,
+                                             payload_size, out_map, out_size);
+            } else {
+                if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) < 0) {
+                    ret = XEX_ERR_IO;
+                    break;
+                }
+                ret = extract_payload(view, parsed, decrypted, payload_size,
+                                      fd);
+            }
+            if (ret == XEX_OK) {
+                break;
+            }
+        }
+        free(decrypted);
+    } else {
+        ret = XEX_ERR_UNSUPPORTED;
+    }
+
+    if (out_map) {
+        munmap(out_map, out_size);
+    }
+    close(fd);
+    if (ret != XEX_OK) {
+        unlink(out_path);
+    }
+    return ret;
+}
@@ -0,0 +1,421 @@
+/*
+ * libxextool - XEX file parsing library
+ *
+ * Embeddable parsing core behind the xextool CLI.  The library parses
+ * into a caller-provided arena so the parse path performs no heap
+ * allocations, and reports failures through status codes rather than
+ * printing - callers decide how to surface errors.
+ */
+
+#ifndef XEXTOOL_XEX_H
+#define XEXTOOL_XEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* XEX2 Header structure (big-endian) */
+typedef struct {
+    uint32_t magic;              /* "XEX2" */
+    uint32_t module_flags;
+    uint32_t pe_offset;
+    uint32_t reserved;
+    uint32_t security_offset;
+    uint32_t optional_header_count;
+} __attribute__((packed)) XEX2_Header;
+
+/* FILE_FORMAT_INFO structure */
+typedef struct {
+    uint32_t info_size;
+    uint16_t encryption_type;
+    uint16_t compression_type;
+} __attribute__((packed)) FileFormatInfo;
+
+/* Constants */
+#define XEX2_MAGIC 0x58455832           /* "XEX2" in big-endian */
+
+/* Optional header keys */
+#define XEX_HEADER_RESOURCE_INFO        0x000002FF
+#define XEX_HEADER_FILE_FORMAT_INFO     0x000003FF
+#define XEX_HEADER_ENTRY_POINT          0x00010100
+#define XEX_HEADER_IMAGE_BASE_ADDRESS   0x00010201
+#define XEX_HEADER_IMPORT_LIBRARIES     0x000103FF
+#define XEX_HEADER_DELTA_PATCH          0x000005FF
+
+/* Encryption types */
+#define XEX_ENCRYPTION_NONE   0
+#define XEX_ENCRYPTION_NORMAL 1
+
+/* Compression types */
+#define XEX_COMPRESSION_NONE   0
+#define XEX_COMPRESSION_BASIC  1
+#define XEX_COMPRESSION_NORMAL 2
+#define XEX_COMPRESSION_DELTA  3
+
+/* Status codes returned by the library */
+#define XEX_OK              0
+#define XEX_ERR_IO          1   /* Cannot open/stat/read the file */
+#define XEX_ERR_TRUNCATED   2   /* File too small for a structure */
+#define XEX_ERR_MAGIC       3   /* Magic number mismatch */
+#define XEX_ERR_NOMEM       4   /* Arena exhausted / out of memory */
+#define XEX_ERR_UNSUPPORTED 5   /* Feature not supported for this image */
+#define XEX_ERR_FORMAT      6   /* Malformed compression/encryption data */
+
+/* Byte order helpers */
+uint32_t be32_to_cpu(uint32_t val);
+uint16_t be16_to_cpu(uint16_t val);
+void be32_to_cpu_array(uint32_t *buf, size_t n);
+
+/* Human-readable type names */
+const char *get_encryption_name(uint16_t type);
+const char *get_compression_name(uint16_t type);
+const char *xex_strerror(int status);
+
+/*
+ * Name of a documented optional header key (NULL when unknown).
+ * Backed by a compile-time sorted key table and binary search, so
+ * identification stays cheap as coverage grows.
+ */
+const char *xex_header_key_name(uint32_t key);
+
+/*
+ * Memory view of a XEX file.  The preferred path maps the whole file
+ * once (mmap) so structure access is pointer arithmetic with zero
+ * copies; when mapping is unavailable the file is pulled into a heap
+ * buffer with a single bulk read instead.
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    int is_mapped;     /* 1 = munmap on release, 0 = free */
+} XexView;
+
+int xex_view_open(const char *filename, XexView *view, int use_mmap);
+void xex_view_close(XexView *view);
+
+/*
+ * Bump allocator over a caller-provided buffer.  All storage the parser
+ * needs (the optional header table) comes from here.  When the fixed
+ * buffer runs out the arena grows by chaining heap chunks, so the full
+ * table is always retained no matter how large; earlier allocations
+ * never move.  Call xex_arena_release() when done - it is a no-op if
+ * the fixed buffer sufficed.
+ */
+typedef struct XexArenaChunk XexArenaChunk;
+
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    XexArenaChunk *chunks;  /* Heap overflow chain, newest first */
+} XexArena;
+
+void xex_arena_init(XexArena *arena, void *buf, size_t size);
+void *xex_arena_alloc(XexArena *arena, size_t size);
+void xex_arena_release(XexArena *arena);
+
+/* One optional header entry, already converted to host byte order */
+typedef struct {
+    uint32_t key;
+    uint32_t value;
+} XexOptHeader;
+
+/* Parsed XEX image, all fields in host byte order */
+typedef struct {
+    uint32_t module_flags;
+    uint32_t pe_offset;
+    uint32_t security_offset;
+    uint32_t opt_count;              /* Entries in opt_headers */
+    const XexOptHeader *opt_headers; /* Arena-allocated table */
+    int has_file_format_info;
+    uint32_t file_format_info_offset;
+    uint32_t info_size;
+    uint16_t encryption_type;
+    uint16_t compression_type;
+} XexParsed;
+
+/*
+ * Parse the XEX headers out of a view.  The optional header table is
+ * copied into the arena and bulk-converted; FILE_FORMAT_INFO is decoded
+ * when present.  Returns XEX_OK or an XEX_ERR_* status.
+ */
+int xex_parse(const XexView *view, XexArena *arena, XexParsed *out);
+
+/*
+ * Parse the XEX headers from a non-seekable descriptor (pipe, socket,
+ * stdin) in a strict single forward pass.  FILE_FORMAT_INFO decoding is
+ * deferred until its offset streams by; bytes between the optional
+ * header table and that offset are discarded.  On return *consumed
+ * holds the number of bytes read from the descriptor.  Returns XEX_OK
+ * or an XEX_ERR_* status; XEX_ERR_FORMAT if FILE_FORMAT_INFO points
+ * backwards into data already consumed.
+ */
+int xex_parse_stream(int fd, XexArena *arena, XexParsed *out,
+                     uint64_t *consumed);
+
+/* Look up an optional header by key; returns NULL when absent */
+const XexOptHeader *xex_find_header(const XexParsed *parsed, uint32_t key);
+
+/*
+ * ---- Basefile extraction ----
+ *
+ * FILE_FORMAT_INFO carries a compression descriptor after the fixed
+ * fields: Basic compression is an array of {data_size, zero_size} block
+ * pairs, Normal compression an LZX window size plus the first
+ * compressed block descriptor.
+ */
+
+/* One Basic-compression block descriptor (big-endian on disk) */
+typedef struct {
+    uint32_t data_size;
+    uint32_t zero_size;
+} __attribute__((packed)) XexBasicBlock;
+
+/* Normal-compression descriptor (big-endian on disk) */
+typedef struct {
+    uint32_t window_size;
+    uint32_t block_size;
+    uint8_t block_hash[20];
+} __attribute__((packed)) XexNormalCompressionInfo;
+
+/* Uncompressed image size from the security info block (0 on failure) */
+uint32_t xex_image_size(const XexView *view, const XexParsed *parsed);
+
+/* Image load address from the security info block (0 on failure) */
+uint32_t xex_load_address(const XexView *view, const XexParsed *parsed);
+
+/*
+ * ---- Security info block ----
+ *
+ * The security_offset header field points at a fixed-layout block in
+ * the plaintext header region: image size, RSA signature, image flags,
+ * load address, the image digest, the wrapped session key, and region
+ * and media flags, followed by per-page hash descriptors.  Decoding it
+ * is a handful of loads, so a caller can accept or reject an image
+ * before committing to decryption or a recompile.
+ */
+
+/* Size of the fixed security info fields (page descriptors follow) */
+#define XEX_SECURITY_INFO_SIZE 0x180
+
+/* Decoded security info block (host byte order) */
+typedef struct {
+    uint32_t header_size;        /* Block size including page descriptors */
+    uint32_t image_size;         /* Uncompressed basefile size */
+    uint32_t image_flags;
+    uint32_t load_address;
+    uint8_t image_digest[20];    /* SHA-1 over the image pages */
+    uint32_t import_table_count;
+    uint32_t export_table_address;
+    uint32_t game_regions;
+    uint32_t media_flags;
+} XexSecurityInfo;
+
+/*
+ * Decode the security info block out of the view.  XEX_ERR_FORMAT when
+ * the block does not fit between the XEX header and end-of-file.
+ */
+int xex_parse_security(const XexView *view, const XexParsed *parsed,
+                       XexSecurityInfo *out);
+
+/*
+ * Accept/reject gate over a decoded block: checks that the block stays
+ * inside the header region and that the image size and load address
+ * describe a page-aligned, non-wrapping mapping.  XEX_OK to accept,
+ * XEX_ERR_FORMAT to reject.
+ */
+int xex_security_validate(const XexView *view, const XexParsed *parsed,
+                          const XexSecurityInfo *sec);
+
+/*
+ * ---- PE basefile headers ----
+ *
+ * When the basefile is stored in the clear (no encryption, no
+ * compression) the embedded PE image starts at pe_offset and its
+ * COFF/section headers can be decoded straight out of the view,
+ * touching only the pages that hold the headers - the image body is
+ * never read.
+ */
+
+/* Windows loader section limit, used as a sanity bound */
+#define XEX_PE_MAX_SECTIONS 96
+
+/* One section out of the PE section table (host byte order) */
+typedef struct {
+    char name[9];                /* NUL-terminated section name */
+    uint32_t virtual_size;
+    uint32_t virtual_address;    /* RVA */
+    uint32_t raw_size;
+    uint32_t raw_offset;
+    uint32_t characteristics;
+} XexPeSection;
+
+/* Decoded PE/COFF header summary */
+typedef struct {
+    uint16_t machine;
+    uint16_t section_count;
+    uint32_t timestamp;
+    uint32_t entry_point_rva;
+    uint32_t image_base;
+    const XexPeSection *sections;    /* Arena-allocated table */
+} XexPeInfo;
+
+/*
+ * Decode the embedded PE headers and section table into the arena.
+ * XEX_ERR_UNSUPPORTED when the basefile is encrypted or compressed,
+ * XEX_ERR_FORMAT when the PE headers are malformed.
+ */
+int xex_parse_pe(const XexView *view, const XexParsed *parsed,
+                 XexArena *arena, XexPeInfo *out);
+
+/*
+ * ---- Import libraries ----
+ *
+ * The IMPORT_LIBRARIES optional header points at a block in the
+ * (plaintext) header region: a string table of library names followed
+ * by one record per library listing the image addresses of its import
+ * slots.  The parsed table offers O(1) lookup by library name, and -
+ * once the decrypted basefile is available - by ordinal, so resolving
+ * kernel imports during recompilation is a hash probe instead of a
+ * linear scan per symbol.
+ */
+
+/* One import library, name pointing into the view */
+typedef struct {
+    const char *name;
+    uint32_t id;
+    uint32_t version;
+    uint32_t version_min;
+    uint32_t record_count;
+    const uint32_t *records;     /* Import slot addresses, host order */
+} XexImportLibrary;
+
+/* One resolved import slot (requires the decrypted basefile) */
+typedef struct {
+    uint32_t library_index;
+    uint32_t ordinal;
+    uint32_t type;               /* 0/1 data, 2 function thunk */
+    uint32_t address;            /* Image address of the slot */
+} XexImportSymbol;
+
+/* Parsed import table with hash indexes (all storage from the arena) */
+typedef struct {
+    uint32_t library_count;
+    XexImportLibrary *libraries;
+    /* Name index: buckets of library indexes, -1 = empty */
+    uint32_t name_buckets;
+    int32_t *name_index;
+    /* Ordinal index over resolved symbols, filled by xex_import_resolve */
+    uint32_t symbol_count;
+    XexImportSymbol *symbols;
+    uint32_t symbol_buckets;
+    int32_t *symbol_index;
+} XexImportTable;
+
+/* Decode the import libraries block; XEX_ERR_UNSUPPORTED when absent */
+int xex_parse_imports(const XexView *view, const XexParsed *parsed,
+                      XexArena *arena, XexImportTable *table);
+
+/* O(1) lookup of a library by name; NULL when absent */
+const XexImportLibrary *xex_import_find_library(const XexImportTable *table,
+                                                const char *name);
+
+/*
+ * Resolve import ordinals by reading each import slot out of the
+ * decrypted basefile image (as produced by xex_extract_basefile) and
+ * build the ordinal hash index.
+ */
+int xex_import_resolve(XexImportTable *table, XexArena *arena,
+                       const uint8_t *image, size_t image_size,
+                       uint32_t load_address);
+
+/* O(1) lookup of a resolved import by library index and ordinal */
+const XexImportSymbol *xex_import_find_ordinal(const XexImportTable *table,
+                                               uint32_t library_index,
+                                               uint32_t ordinal);
+
+/*
+ * Extract the PE basefile to out_path.  Handles uncompressed, Basic
+ * (zero-block) and Normal (LZX) compression; the image must not be
+ * encrypted.  Basic extraction streams block-at-a-time with no
+ * intermediate files.
+ */
+int xex_extract_basefile(const XexView *view, const XexParsed *parsed,
+                         const char *out_path);
+
+/*
+ * Zero-copy extraction for stored (unencrypted, uncompressed)
+ * basefiles: the kernel moves the byte range starting at pe_offset
+ * with copy_file_range/sendfile, never touching userspace buffers.
+ * XEX_ERR_UNSUPPORTED when the image needs decryption/decompression.
+ */
+int xex_extract_basefile_zerocopy(const char *in_path,
+                                  const XexParsed *parsed,
+                                  const char *out_path);
+
+/*
+ * ---- Random access into compressed basefiles ----
+ *
+ * Basic compression is a chain of stored blocks interleaved with
+ * zero-fill, so any uncompressed range maps to a handful of payload
+ * ranges.  The block index is built in one pass over the descriptor
+ * table (header pages only) and xex_read_at then touches just the
+ * payload bytes covering the requested range - no bulk extract.
+ * Normal (LZX) images keep window state across blocks and cannot be
+ * entered mid-stream, so they report XEX_ERR_UNSUPPORTED, as do
+ * encrypted images.
+ */
+
+/* One block's placement in the uncompressed image */
+typedef struct {
+    uint32_t uncompressed_offset;    /* Start in the rebuilt image */
+    uint32_t payload_offset;         /* Start of stored bytes at pe_offset */
+    uint32_t data_size;              /* Stored bytes */
+    uint32_t zero_size;              /* Zero-fill following them */
+} XexBlockMapEntry;
+
+/* Index over the block chain (entries arena-allocated) */
+typedef struct {
+    uint32_t entry_count;
+    const XexBlockMapEntry *entries;
+    uint32_t total_size;             /* Uncompressed image size */
+} XexBlockIndex;
+
+/* Build the block index; works for NONE and BASIC compression */
+int xex_block_index_build(const XexView *view, const XexParsed *parsed,
+                          XexArena *arena, XexBlockIndex *index);
+
+/*
+ * Read len uncompressed bytes starting at offset into buf,
+ * decompressing only the blocks covering the range.
+ */
+int xex_read_at(const XexView *view, const XexParsed *parsed,
+                const XexBlockIndex *index, uint32_t offset,
+                uint8_t *buf, size_t len);
+
+/*
+ * ---- Delta patches ----
+ *
+ * A Delta-compressed payload is a stream of records against a base
+ * image: each record copies a byte range out of the base, then appends
+ * literal bytes carried in the patch.  Records are consumed until the
+ * payload is exhausted, so application is a single streaming pass over
+ * both files.
+ */
+
+/* One delta record header (big-endian on disk, literals follow) */
+typedef struct {
+    uint32_t base_offset;    /* Copy source in the base image */
+    uint32_t base_size;      /* Bytes to copy from the base */
+    uint32_t data_size;      /* Literal bytes following this header */
+} __attribute__((packed)) XexDeltaRecord;
+
+/*
+ * Apply a Delta-compressed patch against a base image and write the
+ * rebuilt basefile to out_path.  The patch must be unencrypted;
+ * XEX_ERR_UNSUPPORTED otherwise or when the patch is not
+ * XEX_COMPRESSION_DELTA.
+ */
+int xex_apply_delta(const XexView *base, const XexView *patch,
+                    const XexParsed *patch_parsed, const char *out_path);
+
+#endif /* XEXTOOL_XEX_H */
@@ -1,96 +1,117 @@
 /*
  * xextool - XEX File Analysis Tool
- * 
+ *
  * A simple utility to analyze Xbox 360 executable (XEX) files.
- * This tool parses and displays XEX file headers and structure information,
- * including encryption and compression details.
+ * This tool is a thin command-line client of libxextool (xex.h): the
+ * library does the parsing, this file does option handling and output
+ * formatting, including encryption and compression details.
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <dirent.h>
+#include <pthread.h>
 
-/* XEX2 Header structure (big-endian) */
-typedef struct {
-    uint32_t magic;              /* "XEX2" */
-    uint32_t module_flags;
-    uint32_t pe_offset;
-    uint32_t reserved;
-    uint32_t security_offset;
-    uint32_t optional_header_count;
-} __attribute__((packed)) XEX2_Header;
-
-/* FILE_FORMAT_INFO structure */
-typedef struct {
-    uint32_t info_size;
-    uint16_t encryption_type;
-    uint16_t compression_type;
-} __attribute__((packed)) FileFormatInfo;
-
-/* Constants */
-#define XEX2_MAGIC 0x58455832           /* "XEX2" in big-endian */
-#define MAX_OPTIONAL_HEADERS 100         /* Sanity check limit */
-#define DISPLAY_HEADER_LIMIT 20          /* Number of headers to display */
-
-/* Optional header keys */
-#define XEX_HEADER_FILE_FORMAT_INFO     0x000003FF
-#define XEX_HEADER_ENTRY_POINT          0x00010100
-#define XEX_HEADER_IMAGE_BASE_ADDRESS   0x00010201
-#define XEX_HEADER_IMPORT_LIBRARIES     0x000103FF
-#define XEX_HEADER_DELTA_PATCH          0x000005FF
-
-/* Encryption types */
-#define XEX_ENCRYPTION_NONE   0
-#define XEX_ENCRYPTION_NORMAL 1
-
-/* Compression types */
-#define XEX_COMPRESSION_NONE   0
-#define XEX_COMPRESSION_BASIC  1
-#define XEX_COMPRESSION_NORMAL 2
-#define XEX_COMPRESSION_DELTA  3
+#include "xex.h"
+#include "cache.h"
+#include "mapindex.h"
+#include "sha1.h"
+#include "xpr.h"
+
+/* Fixed first block of the parse arena; the arena grows onto the heap
+ * for images with larger optional header tables */
+#define PARSE_ARENA_SIZE 1024
+
+/* Arena for import table parsing (records plus hash indexes) */
+#define IMPORT_ARENA_SIZE (256 * 1024)
+
+/* Arena for the PE section table */
+#define PE_ARENA_SIZE (XEX_PE_MAX_SECTIONS * sizeof(XexPeSection) + 64)
+
+/* Hex formatting for SHA-1 digests (defined with the verify mode) */
+static void digest_to_hex(const uint8_t digest[SHA1_DIGEST_SIZE],
+                          char out[SHA1_DIGEST_SIZE * 2 + 1]);
 
 /* Global flags for verbose and encryption display */
 static int verbose_mode = 0;
 static int show_encryption = 0;
+static int use_mmap = 1;   /* Zero-copy mmap parsing (default); fall back to read */
+static int json_mode = 0;  /* Emit one NDJSON record per file instead of text */
+static const char *cache_dir = NULL;   /* Persistent analysis cache (--cache) */
 
-/* Helper function to convert big-endian to host byte order (32-bit) */
-uint32_t be32_to_cpu(uint32_t val) {
-    return ((val & 0xFF000000) >> 24) |
-           ((val & 0x00FF0000) >> 8)  |
-           ((val & 0x0000FF00) << 8)  |
-           ((val & 0x000000FF) << 24);
-}
+/*
+ * ---- Hot-path instrumentation ----
+ *
+ * --stats accumulates nanosecond counters around each stage (open,
+ * header parse, extraction, output formatting) plus bytes read, and
+ * emits one JSON summary at exit.  Every probe is guarded by a single
+ * predictable branch on stats_mode, so the disabled hot path pays one
+ * untaken compare per stage and no clock reads.
+ */
+static int stats_mode = 0;
 
-/* Helper function to convert big-endian to host byte order (16-bit) */
-uint16_t be16_to_cpu(uint16_t val) {
-    return ((val & 0xFF00) >> 8) |
-           ((val & 0x00FF) << 8);
+/* Per-run counters, atomically accumulated so scan workers can share */
+static struct {
+    uint64_t files;
+    uint64_t open_ns;
+    uint64_t parse_ns;
+    uint64_t extract_ns;
+    uint64_t format_ns;
+    uint64_t bytes_read;
+} stats;
+
+/* Monotonic clock in nanoseconds; 0 when stats are off */
+static uint64_t stats_now(void) {
+    if (!stats_mode) {
+        return 0;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 }
 
-/* Get encryption type name */
-const char* get_encryption_name(uint16_t type) {
-    switch (type) {
-        case XEX_ENCRYPTION_NONE:   return "None";
-        case XEX_ENCRYPTION_NORMAL: return "Normal (Encrypted)";
-        default:                    return "Unknown";
+/* Charge the time since start to one counter */
+static void stats_add(uint64_t *counter, uint64_t start) {
+    if (stats_mode) {
+        __atomic_fetch_add(counter, stats_now() - start, __ATOMIC_RELAXED);
     }
 }
 
-/* Get compression type name */
-const char* get_compression_name(uint16_t type) {
-    switch (type) {
-        case XEX_COMPRESSION_NONE:   return "None";
-        case XEX_COMPRESSION_BASIC:  return "Basic";
-        case XEX_COMPRESSION_NORMAL: return "Normal";
-        case XEX_COMPRESSION_DELTA:  return "Delta";
-        default:                     return "Unknown";
+/* Count bytes pulled off the device */
+static void stats_add_bytes(uint64_t bytes) {
+    if (stats_mode) {
+        __atomic_fetch_add(&stats.bytes_read, bytes, __ATOMIC_RELAXED);
     }
 }
 
+/* Emit the accumulated counters as one JSON record on stderr */
+static void stats_emit(void) {
+    fprintf(stderr,
+            "{\"stats\":{\"files\":%llu,\"open_ns\":%llu,\"parse_ns\":%llu"
+            ",\"extract_ns\":%llu,\"format_ns\":%llu,\"bytes_read\":%llu}}\n",
+            (unsigned long long)stats.files,
+            (unsigned long long)stats.open_ns,
+            (unsigned long long)stats.parse_ns,
+            (unsigned long long)stats.extract_ns,
+            (unsigned long long)stats.format_ns,
+            (unsigned long long)stats.bytes_read);
+}
+
 /* Display file size in human-readable format */
 void print_file_size(off_t size) {
     if (size < 1024) {
@@ -102,240 +123,2676 @@ void print_file_size(off_t size) {
     }
 }
 
+/* Open and parse one file, reporting errors to stderr */
+static int open_and_parse(const char *filename, XexView *view,
+                          XexArena *arena, XexParsed *parsed) {
+    uint64_t t_open = stats_now();
+    int status = xex_view_open(filename, view, use_mmap);
+    stats_add(&stats.open_ns, t_open);
+    if (status != XEX_OK) {
+        fprintf(stderr, "ERROR: Cannot open file '%s'\n", filename);
+        return status;
+    }
+    if (stats_mode) {
+        __atomic_fetch_add(&stats.files, 1, __ATOMIC_RELAXED);
+        stats_add_bytes(view->size);
+    }
+
+    uint64_t t_parse = stats_now();
+    status = xex_parse(view, arena, parsed);
+    stats_add(&stats.parse_ns, t_parse);
+    if (status == XEX_ERR_TRUNCATED) {
+        fprintf(stderr, "ERROR: Cannot read XEX header\n");
+        xex_view_close(view);
+    } else if (status == XEX_ERR_MAGIC) {
+        fprintf(stderr, "ERROR: Invalid XEX file - magic number mismatch\n");
+        fprintf(stderr, "Expected: 0x%08X (XEX2)\n", XEX2_MAGIC);
+        fprintf(stderr, "Got:      0x%08X\n",
+                be32_to_cpu(((const XEX2_Header *)view->data)->magic));
+        xex_view_close(view);
+    } else if (status != XEX_OK) {
+        fprintf(stderr, "ERROR: %s while parsing '%s'\n",
+                xex_strerror(status), filename);
+        xex_view_close(view);
+    }
+    return status;
+}
+
+/*
+ * Parse a file's header summary, consulting the persistent cache when
+ * --cache is active.  On a cache hit the file itself is never opened;
+ * on a miss the result is parsed and stored for the next run.
+ */
+static int get_parsed(const char *filename, XexArena *arena,
+                      XexParsed *parsed, size_t *file_size) {
+    if (cache_dir &&
+        cache_lookup(cache_dir, filename, arena, parsed, file_size) == XEX_OK) {
+        return XEX_OK;
+    }
+
+    XexView view;
+    int status = open_and_parse(filename, &view, arena, parsed);
+    if (status != XEX_OK) {
+        return status;
+    }
+    *file_size = view.size;
+    xex_view_close(&view);
+
+    if (cache_dir) {
+        cache_store(cache_dir, filename, parsed);
+    }
+    return XEX_OK;
+}
+
 /* Analyze XEX file */
 int analyze_xex_file(const char *filename) {
-    FILE *fp;
-    XEX2_Header header;
-    struct stat st;
-    uint32_t magic;
-    uint32_t file_format_info_offset = 0;
-    int has_encryption_info = 0;
-    
+    XexArena arena;
+    XexParsed parsed;
+    size_t file_size;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+
     printf("========================================\n");
     printf("XEX File Analysis Tool\n");
     printf("========================================\n\n");
-    
-    /* Open file */
-    fp = fopen(filename, "rb");
-    if (!fp) {
-        fprintf(stderr, "ERROR: Cannot open file '%s'\n", filename);
-        return 1;
-    }
-    
-    /* Get file size */
-    if (stat(filename, &st) != 0) {
-        fprintf(stderr, "ERROR: Cannot stat file '%s'\n", filename);
-        fclose(fp);
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    if (get_parsed(filename, &arena, &parsed, &file_size) != XEX_OK) {
         return 1;
     }
-    
+
+    uint64_t t_format = stats_now();
+
     printf("File: %s\n", filename);
     printf("Size: ");
-    print_file_size(st.st_size);
-    printf(" (%ld bytes)\n\n", (long)st.st_size);
-    
-    /* Read header */
-    if (fread(&header, sizeof(header), 1, fp) != 1) {
-        fprintf(stderr, "ERROR: Cannot read XEX header\n");
-        fclose(fp);
-        return 1;
-    }
-    
-    /* Verify magic number */
-    magic = be32_to_cpu(header.magic);
-    if (magic != XEX2_MAGIC) {
-        fprintf(stderr, "ERROR: Invalid XEX file - magic number mismatch\n");
-        fprintf(stderr, "Expected: 0x%08X (XEX2)\n", XEX2_MAGIC);
-        fprintf(stderr, "Got:      0x%08X\n", magic);
-        fclose(fp);
-        return 1;
-    }
-    
+    print_file_size(file_size);
+    printf(" (%ld bytes)\n\n", (long)file_size);
+
     printf("=== XEX2 Header ===\n");
     printf("Magic:                XEX2 (valid)\n");
-    printf("Module Flags:         0x%08X\n", be32_to_cpu(header.module_flags));
-    printf("PE Offset:            0x%08X\n", be32_to_cpu(header.pe_offset));
-    printf("Security Offset:      0x%08X\n", be32_to_cpu(header.security_offset));
-    printf("Optional Header Count: %u\n", be32_to_cpu(header.optional_header_count));
-    
+    printf("Module Flags:         0x%08X\n", parsed.module_flags);
+    printf("PE Offset:            0x%08X\n", parsed.pe_offset);
+    printf("Security Offset:      0x%08X\n", parsed.security_offset);
+    printf("Optional Header Count: %u\n", parsed.opt_count);
+
     if (verbose_mode) {
         printf("\nVerbose mode: ON\n");
     }
     printf("\n");
-    
-    /* Read and display optional headers */
-    uint32_t opt_count = be32_to_cpu(header.optional_header_count);
-    if (opt_count > 0 && opt_count < MAX_OPTIONAL_HEADERS) {  /* Sanity check */
+
+    /* Display the optional header table */
+    if (parsed.opt_count > 0) {
         printf("=== Optional Headers ===\n");
-        
-        for (uint32_t i = 0; i < opt_count && i < DISPLAY_HEADER_LIMIT; i++) {
-            uint32_t key, value;
-            if (fread(&key, sizeof(key), 1, fp) != 1 ||
-                fread(&value, sizeof(value), 1, fp) != 1) {
-                break;
-            }
-            
-            key = be32_to_cpu(key);
-            value = be32_to_cpu(value);
-            
-            /* Check if this is FILE_FORMAT_INFO header */
-            if (key == XEX_HEADER_FILE_FORMAT_INFO) {
-                file_format_info_offset = value;
-                has_encryption_info = 1;
-            }
-            
+
+        for (uint32_t i = 0; i < parsed.opt_count; i++) {
+            uint32_t key = parsed.opt_headers[i].key;
+            uint32_t value = parsed.opt_headers[i].value;
+
             if (verbose_mode || show_encryption) {
                 printf("  [%2u] Key: 0x%08X  Value: 0x%08X", i, key, value);
-                
-                /* Display known header types */
-                switch (key) {
-                    case XEX_HEADER_FILE_FORMAT_INFO:
-                        printf(" (FILE_FORMAT_INFO)");
-                        break;
-                    case XEX_HEADER_ENTRY_POINT:
-                        printf(" (ENTRY_POINT)");
-                        break;
-                    case XEX_HEADER_IMAGE_BASE_ADDRESS:
-                        printf(" (IMAGE_BASE_ADDRESS)");
-                        break;
-                    case XEX_HEADER_IMPORT_LIBRARIES:
-                        printf(" (IMPORT_LIBRARIES)");
-                        break;
-                    case XEX_HEADER_DELTA_PATCH:
-                        printf(" (DELTA_PATCH_DESCRIPTOR)");
-                        break;
+
+                /* Display known header types via the sorted key table */
+                const char *name = xex_header_key_name(key);
+                if (name) {
+                    printf(" (%s)", name);
                 }
                 printf("\n");
             }
         }
-        
-        if (verbose_mode && opt_count > DISPLAY_HEADER_LIMIT) {
-            printf("  ... (%u more headers)\n", opt_count - DISPLAY_HEADER_LIMIT);
-        }
-        
+
         if (verbose_mode || show_encryption) {
             printf("\n");
         }
     }
-    
-    /* Parse and display FILE_FORMAT_INFO if encryption details requested */
-    if (has_encryption_info && (show_encryption || verbose_mode)) {
+
+    /* Decode the security info block straight from the view */
+    {
+        XexView view;
+        if (xex_view_open(filename, &view, use_mmap) == XEX_OK) {
+            XexSecurityInfo sec;
+            if (xex_parse_security(&view, &parsed, &sec) == XEX_OK) {
+                char digest_hex[SHA1_DIGEST_SIZE * 2 + 1];
+                digest_to_hex(sec.image_digest, digest_hex);
+                printf("=== Security Info ===\n");
+                printf("Image Size:           0x%08X (%u bytes)\n",
+                       sec.image_size, sec.image_size);
+                printf("Load Address:         0x%08X\n", sec.load_address);
+                printf("Image Flags:          0x%08X\n", sec.image_flags);
+                printf("Game Regions:         0x%08X\n", sec.game_regions);
+                printf("Media Flags:          0x%08X\n", sec.media_flags);
+                printf("Image Digest:         %s\n", digest_hex);
+                printf("Validation:           %s\n",
+                       xex_security_validate(&view, &parsed, &sec) == XEX_OK
+                           ? "accept" : "REJECT");
+                printf("\n");
+            }
+            xex_view_close(&view);
+        }
+    }
+
+    /* Display FILE_FORMAT_INFO if encryption details requested */
+    if (parsed.has_file_format_info && (show_encryption || verbose_mode)) {
         printf("=== FILE_FORMAT_INFO (Encryption & Compression Details) ===\n");
-        
-        /* Seek to FILE_FORMAT_INFO offset */
-        if (fseek(fp, file_format_info_offset, SEEK_SET) != 0) {
-            fprintf(stderr, "ERROR: Cannot seek to FILE_FORMAT_INFO at offset 0x%08X\n", 
-                    file_format_info_offset);
-        } else {
-            FileFormatInfo ffi;
-            if (fread(&ffi, sizeof(ffi), 1, fp) == 1) {
-                uint32_t info_size = be32_to_cpu(ffi.info_size);
-                uint16_t encryption = be16_to_cpu(ffi.encryption_type);
-                uint16_t compression = be16_to_cpu(ffi.compression_type);
-                
-                printf("Info Size:         %u bytes\n", info_size);
-                printf("Encryption Type:   %u (%s)\n", encryption, get_encryption_name(encryption));
-                printf("Compression Type:  %u (%s)\n", compression, get_compression_name(compression));
-                
-                /* Display encryption status clearly */
-                if (show_encryption) {
-                    printf("\n");
-                    printf("*** ENCRYPTION STATUS ***\n");
-                    if (encryption == XEX_ENCRYPTION_NONE) {
-                        printf("This XEX file is NOT encrypted\n");
-                    } else if (encryption == XEX_ENCRYPTION_NORMAL) {
-                        printf("This XEX file IS ENCRYPTED (Normal encryption)\n");
-                        printf("Decryption required before further processing\n");
-                    } else {
-                        printf("This XEX file has UNKNOWN encryption type (%u)\n", encryption);
-                    }
-                    printf("*************************\n");
-                }
-                
-                /* Verbose mode: Additional compression details */
-                if (verbose_mode) {
-                    printf("\nCompression Analysis:\n");
-                    if (compression == XEX_COMPRESSION_NONE) {
-                        printf("  - File is not compressed\n");
-                    } else if (compression == XEX_COMPRESSION_DELTA) {
-                        printf("  - WARNING: Delta compression requires base file\n");
-                        printf("  - This compression type may not be supported by all tools\n");
-                    } else {
-                        printf("  - Decompression may be required before processing\n");
-                    }
-                }
+
+        printf("Info Size:         %u bytes\n", parsed.info_size);
+        printf("Encryption Type:   %u (%s)\n", parsed.encryption_type,
+               get_encryption_name(parsed.encryption_type));
+        printf("Compression Type:  %u (%s)\n", parsed.compression_type,
+               get_compression_name(parsed.compression_type));
+
+        /* Display encryption status clearly */
+        if (show_encryption) {
+            printf("\n");
+            printf("*** ENCRYPTION STATUS ***\n");
+            if (parsed.encryption_type == XEX_ENCRYPTION_NONE) {
+                printf("This XEX file is NOT encrypted\n");
+            } else if (parsed.encryption_type == XEX_ENCRYPTION_NORMAL) {
+                printf("This XEX file IS ENCRYPTED (Normal encryption)\n");
+                printf("Decryption required before further processing\n");
+            } else {
+                printf("This XEX file has UNKNOWN encryption type (%u)\n",
+                       parsed.encryption_type);
+            }
+            printf("*************************\n");
+        }
+
+        /* Verbose mode: Additional compression details */
+        if (verbose_mode) {
+            printf("\nCompression Analysis:\n");
+            if (parsed.compression_type == XEX_COMPRESSION_NONE) {
+                printf("  - File is not compressed\n");
+            } else if (parsed.compression_type == XEX_COMPRESSION_DELTA) {
+                printf("  - WARNING: Delta compression requires base file\n");
+                printf("  - This compression type may not be supported by all tools\n");
             } else {
-                fprintf(stderr, "ERROR: Cannot read FILE_FORMAT_INFO structure\n");
+                printf("  - Decompression may be required before processing\n");
             }
         }
         printf("\n");
-    } else if (show_encryption && !has_encryption_info) {
+    } else if (show_encryption && !parsed.has_file_format_info) {
         printf("=== ENCRYPTION STATUS ===\n");
         printf("WARNING: FILE_FORMAT_INFO header not found\n");
         printf("Cannot determine encryption status\n");
         printf("This may be an unusual or corrupted XEX file\n\n");
     }
-    
+
+    /* Verbose mode: decode the embedded PE headers when stored in the
+     * clear.  Only the header pages are ever touched. */
+    if (verbose_mode) {
+        XexView view;
+        if (xex_view_open(filename, &view, use_mmap) == XEX_OK) {
+            XexArena pe_arena;
+            XexPeInfo pe;
+            uint8_t pe_arena_buf[PE_ARENA_SIZE];
+            xex_arena_init(&pe_arena, pe_arena_buf, sizeof(pe_arena_buf));
+            if (xex_parse_pe(&view, &parsed, &pe_arena, &pe) == XEX_OK) {
+                printf("=== PE Basefile ===\n");
+                printf("Machine:           0x%04X\n", pe.machine);
+                printf("Timestamp:         0x%08X\n", pe.timestamp);
+                printf("Entry Point RVA:   0x%08X\n", pe.entry_point_rva);
+                printf("Image Base:        0x%08X\n", pe.image_base);
+                printf("Sections:          %u\n", pe.section_count);
+                for (uint32_t i = 0; i < pe.section_count; i++) {
+                    const XexPeSection *s = &pe.sections[i];
+                    printf("  %-8s  rva=0x%08X vsize=0x%08X raw=0x%08X "
+                           "flags=0x%08X\n",
+                           s->name, s->virtual_address, s->virtual_size,
+                           s->raw_size, s->characteristics);
+                }
+                printf("\n");
+            }
+            xex_arena_release(&pe_arena);
+            xex_view_close(&view);
+        }
+    }
+
+    /* Verbose mode: decode the import libraries block */
+    if (verbose_mode && xex_find_header(&parsed, XEX_HEADER_IMPORT_LIBRARIES)) {
+        XexView view;
+        if (xex_view_open(filename, &view, use_mmap) == XEX_OK) {
+            /* Import records need more room than the parse arena */
+            uint8_t *import_buf = malloc(IMPORT_ARENA_SIZE);
+            if (import_buf) {
+                XexArena import_arena;
+                XexImportTable imports;
+                xex_arena_init(&import_arena, import_buf, IMPORT_ARENA_SIZE);
+                if (xex_parse_imports(&view, &parsed, &import_arena,
+                                      &imports) == XEX_OK) {
+                    printf("=== Import Libraries ===\n");
+                    for (uint32_t i = 0; i < imports.library_count; i++) {
+                        const XexImportLibrary *lib = &imports.libraries[i];
+                        printf("  [%u] %s  version %u.%u.%u.%u  %u imports\n",
+                               i, lib->name,
+                               lib->version >> 28, (lib->version >> 24) & 0xF,
+                               (lib->version >> 8) & 0xFFFF, lib->version & 0xFF,
+                               lib->record_count);
+                    }
+                    printf("\n");
+                }
+                xex_arena_release(&import_arena);
+                free(import_buf);
+            }
+            xex_view_close(&view);
+        }
+    }
+
     printf("========================================\n");
     printf("Analysis complete!\n");
     printf("========================================\n");
-    
-    fclose(fp);
+
+    xex_arena_release(&arena);
+    stats_add(&stats.format_ns, t_format);
     return 0;
 }
 
-/* Display help message */
-void print_usage(const char *prog_name) {
-    fprintf(stderr, "Usage: %s [OPTIONS] <xex-file>\n", prog_name);
-    fprintf(stderr, "\nOptions:\n");
-    fprintf(stderr, "  -v, --verbose      Enable verbose output (shows all optional headers)\n");
-    fprintf(stderr, "  -e, --encryption   Display detailed encryption information\n");
-    fprintf(stderr, "  -h, --help         Show this help message\n");
-    fprintf(stderr, "\nExamples:\n");
-    fprintf(stderr, "  %s dolphin.xex\n", prog_name);
-    fprintf(stderr, "  %s --verbose dolphin.xex\n", prog_name);
-    fprintf(stderr, "  %s --encryption dolphin.xex\n", prog_name);
-    fprintf(stderr, "  %s -v -e dolphin.xex\n", prog_name);
+/*
+ * ---- Streaming analysis ----
+ *
+ * --stream parses from stdin or any pipe in a strict single forward
+ * pass, so images arriving over a socket can be analyzed in flight
+ * without spooling to a temp file.  The file size is unknown up front;
+ * the report shows the bytes consumed from the stream instead.
+ */
+static int analyze_xex_stream(const char *filename) {
+    XexArena arena;
+    XexParsed parsed;
+    uint64_t consumed = 0;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+    int fd = STDIN_FILENO;
+    int status;
+
+    if (strcmp(filename, "-") != 0) {
+        fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "ERROR: Cannot open file '%s'\n", filename);
+            return 1;
+        }
+    }
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    status = xex_parse_stream(fd, &arena, &parsed, &consumed);
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    if (status != XEX_OK) {
+        fprintf(stderr, "ERROR: %s\n", xex_strerror(status));
+        xex_arena_release(&arena);
+        return 1;
+    }
+
+    printf("========================================\n");
+    printf("XEX Stream Analysis\n");
+    printf("========================================\n\n");
+
+    printf("Stream: %s\n", filename);
+    printf("Bytes consumed: %llu\n\n", (unsigned long long)consumed);
+
+    printf("=== XEX2 Header ===\n");
+    printf("Magic:                XEX2 (valid)\n");
+    printf("Module Flags:         0x%08X\n", parsed.module_flags);
+    printf("PE Offset:            0x%08X\n", parsed.pe_offset);
+    printf("Security Offset:      0x%08X\n", parsed.security_offset);
+    printf("Optional Header Count: %u\n\n", parsed.opt_count);
+
+    if ((verbose_mode || show_encryption) && parsed.opt_count > 0) {
+        printf("=== Optional Headers ===\n");
+        for (uint32_t i = 0; i < parsed.opt_count; i++) {
+            uint32_t key = parsed.opt_headers[i].key;
+            printf("  [%2u] Key: 0x%08X  Value: 0x%08X", i, key,
+                   parsed.opt_headers[i].value);
+            const char *name = xex_header_key_name(key);
+            if (name) {
+                printf(" (%s)", name);
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+
+    if (parsed.has_file_format_info) {
+        printf("=== FILE_FORMAT_INFO ===\n");
+        printf("Info Size:         %u bytes\n", parsed.info_size);
+        printf("Encryption Type:   %u (%s)\n", parsed.encryption_type,
+               get_encryption_name(parsed.encryption_type));
+        printf("Compression Type:  %u (%s)\n\n", parsed.compression_type,
+               get_compression_name(parsed.compression_type));
+    }
+
+    printf("========================================\n");
+    printf("Analysis complete!\n");
+    printf("========================================\n");
+    xex_arena_release(&arena);
+    return 0;
 }
 
-int main(int argc, char *argv[]) {
-    int opt;
-    const char *xex_file = NULL;
-    
-    /* Define long options */
-    static struct option long_options[] = {
-        {"verbose",    no_argument, 0, 'v'},
-        {"encryption", no_argument, 0, 'e'},
-        {"help",       no_argument, 0, 'h'},
-        {0, 0, 0, 0}
-    };
-    
-    /* Parse command-line options */
-    while ((opt = getopt_long(argc, argv, "veh", long_options, NULL)) != -1) {
-        switch (opt) {
-            case 'v':
-                verbose_mode = 1;
-                break;
-            case 'e':
-                show_encryption = 1;
-                break;
-            case 'h':
-                print_usage(argv[0]);
-                return 0;
-            default:
-                print_usage(argv[0]);
-                return 1;
+/*
+ * ---- JSON output ----
+ *
+ * --json emits one compact NDJSON record per file so downstream tooling
+ * (xenia_automation.py and friends) can consume results with a single
+ * json.loads per line instead of scraping the decorative text output.
+ * Each record is assembled in a buffer and written with one fwrite.
+ */
+
+/* Output buffer for one NDJSON record */
+typedef struct {
+    char buf[16384];
+    size_t len;
+    int overflow;
+} JsonBuf;
+
+/* Append printf-formatted text to a JSON buffer */
+static void json_append(JsonBuf *jb, const char *fmt, ...) {
+    if (jb->overflow) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(jb->buf + jb->len, sizeof(jb->buf) - jb->len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= sizeof(jb->buf) - jb->len) {
+        jb->overflow = 1;
+    } else {
+        jb->len += (size_t)n;
+    }
+}
+
+/* Append a JSON string value (with escaping) to a buffer */
+static void json_append_string(JsonBuf *jb, const char *s) {
+    json_append(jb, "\"");
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            json_append(jb, "\\%c", c);
+        } else if (c < 0x20) {
+            json_append(jb, "\\u%04x", c);
+        } else {
+            json_append(jb, "%c", c);
         }
     }
-    
-    /* Check if XEX file is provided */
-    if (optind >= argc) {
-        fprintf(stderr, "ERROR: No XEX file specified\n\n");
-        print_usage(argv[0]);
+    json_append(jb, "\"");
+}
+
+/* Format one file's analysis as a single NDJSON record */
+static int xex_format_json(const char *filename, JsonBuf *jb) {
+    XexArena arena;
+    XexParsed parsed;
+    size_t file_size;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+
+    jb->len = 0;
+    jb->overflow = 0;
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    int status = get_parsed(filename, &arena, &parsed, &file_size);
+    if (status == XEX_ERR_IO) {
         return 1;
     }
-    
-    xex_file = argv[optind];
-    
-    return analyze_xex_file(xex_file);
+    if (status != XEX_OK) {
+        /* Invalid image: report its size from the directory entry */
+        struct stat st;
+        file_size = (stat(filename, &st) == 0) ? (size_t)st.st_size : 0;
+    }
+
+    uint64_t t_format = stats_now();
+
+    json_append(jb, "{\"file\":");
+    json_append_string(jb, filename);
+    json_append(jb, ",\"size\":%zu", file_size);
+
+    if (status != XEX_OK) {
+        json_append(jb, ",\"valid\":false}\n");
+        xex_arena_release(&arena);
+        return 0;
+    }
+
+    json_append(jb, ",\"valid\":true");
+    json_append(jb, ",\"module_flags\":%u", parsed.module_flags);
+    json_append(jb, ",\"pe_offset\":%u", parsed.pe_offset);
+    json_append(jb, ",\"security_offset\":%u", parsed.security_offset);
+
+    json_append(jb, ",\"optional_headers\":[");
+    for (uint32_t i = 0; i < parsed.opt_count; i++) {
+        json_append(jb, "%s{\"key\":%u,\"value\":%u", i ? "," : "",
+                    parsed.opt_headers[i].key, parsed.opt_headers[i].value);
+        const char *name = xex_header_key_name(parsed.opt_headers[i].key);
+        if (name) {
+            json_append(jb, ",\"name\":\"%s\"", name);
+        }
+        json_append(jb, "}");
+    }
+    json_append(jb, "]");
+
+    if (parsed.has_file_format_info) {
+        json_append(jb, ",\"encryption\":{\"type\":%u,\"name\":",
+                    parsed.encryption_type);
+        json_append_string(jb, get_encryption_name(parsed.encryption_type));
+        json_append(jb, "},\"compression\":{\"type\":%u,\"name\":",
+                    parsed.compression_type);
+        json_append_string(jb, get_compression_name(parsed.compression_type));
+        json_append(jb, "}");
+    }
+
+    /* Security info, plus the PE headers and section table when the
+     * basefile is stored in the clear - header pages only, the image
+     * body is never read */
+    XexView view;
+    if (xex_view_open(filename, &view, use_mmap) == XEX_OK) {
+        XexSecurityInfo sec;
+        if (xex_parse_security(&view, &parsed, &sec) == XEX_OK) {
+            char digest_hex[SHA1_DIGEST_SIZE * 2 + 1];
+            digest_to_hex(sec.image_digest, digest_hex);
+            json_append(jb, ",\"security\":{\"image_size\":%u"
+                        ",\"load_address\":%u,\"image_flags\":%u"
+                        ",\"game_regions\":%u,\"media_flags\":%u"
+                        ",\"image_digest\":\"%s\",\"valid\":%s}",
+                        sec.image_size, sec.load_address, sec.image_flags,
+                        sec.game_regions, sec.media_flags, digest_hex,
+                        xex_security_validate(&view, &parsed, &sec) == XEX_OK
+                            ? "true" : "false");
+        }
+
+        if (parsed.has_file_format_info &&
+            parsed.encryption_type == XEX_ENCRYPTION_NONE &&
+            parsed.compression_type == XEX_COMPRESSION_NONE) {
+            XexArena pe_arena;
+            XexPeInfo pe;
+            uint8_t pe_arena_buf[PE_ARENA_SIZE];
+            xex_arena_init(&pe_arena, pe_arena_buf, sizeof(pe_arena_buf));
+            if (xex_parse_pe(&view, &parsed, &pe_arena, &pe) == XEX_OK) {
+                json_append(jb, ",\"pe\":{\"machine\":%u,\"timestamp\":%u"
+                            ",\"entry_point_rva\":%u,\"image_base\":%u"
+                            ",\"sections\":[",
+                            pe.machine, pe.timestamp,
+                            pe.entry_point_rva, pe.image_base);
+                for (uint32_t i = 0; i < pe.section_count; i++) {
+                    const XexPeSection *s = &pe.sections[i];
+                    json_append(jb, "%s{\"name\":", i ? "," : "");
+                    json_append_string(jb, s->name);
+                    json_append(jb, ",\"rva\":%u,\"virtual_size\":%u"
+                                ",\"raw_size\":%u,\"flags\":%u}",
+                                s->virtual_address, s->virtual_size,
+                                s->raw_size, s->characteristics);
+                }
+                json_append(jb, "]}");
+            }
+            xex_arena_release(&pe_arena);
+        }
+        xex_view_close(&view);
+    }
+
+    json_append(jb, "}\n");
+    xex_arena_release(&arena);
+    stats_add(&stats.format_ns, t_format);
+
+    if (jb->overflow) {
+        fprintf(stderr, "ERROR: JSON record for '%s' exceeds buffer\n", filename);
+        return 1;
+    }
+    return 0;
+}
+
+/* Analyze one file and emit its NDJSON record with a single write */
+static int analyze_xex_json(const char *filename) {
+    JsonBuf jb;
+    if (xex_format_json(filename, &jb) != 0) {
+        return 1;
+    }
+    fwrite(jb.buf, 1, jb.len, stdout);
+    return 0;
+}
+
+/*
+ * ---- Batch directory scanning ----
+ *
+ * --scan walks a directory tree, queues every .xex file it finds and
+ * analyzes them with a pool of worker threads, so a corpus audit is one
+ * process using N cores instead of one fork/exec per file.
+ */
+
+/* Work queue of file paths shared by the scan workers.  Workers claim
+ * indices with an atomic increment; there is no lock anywhere on the
+ * scan hot path. */
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity;
+    size_t next;                   /* Next unclaimed index (atomic) */
+} ScanQueue;
+
+/*
+ * Per-worker result shard: private counters and a private output
+ * buffer.  Workers never touch shared state while scanning; the main
+ * thread merges the shards after the pool drains, so aggregation costs
+ * nothing in worker-to-worker contention and the scan scales with the
+ * core count.
+ */
+typedef struct {
+    /* Summary statistics */
+    size_t analyzed;
+    size_t invalid;
+    size_t encrypted;
+    size_t compression_counts[4];  /* None/Basic/Normal/Delta */
+    size_t compression_other;
+    /* Buffered report lines, flushed in shard order at the end */
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+} ScanShard;
+
+/* Append raw bytes to a shard's output buffer */
+static int shard_append_data(ScanShard *shard, const char *data, size_t len) {
+    if (shard->out_len + len > shard->out_cap) {
+        size_t new_cap = shard->out_cap ? shard->out_cap * 2 : 4096;
+        while (new_cap < shard->out_len + len) {
+            new_cap *= 2;
+        }
+        char *grown = realloc(shard->out, new_cap);
+        if (!grown) {
+            return 1;
+        }
+        shard->out = grown;
+        shard->out_cap = new_cap;
+    }
+    memcpy(shard->out + shard->out_len, data, len);
+    shard->out_len += len;
+    return 0;
+}
+
+/* Append one printf-formatted report line to a shard */
+static int shard_append(ScanShard *shard, const char *fmt, ...) {
+    char line[4608];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return 1;
+    }
+    if ((size_t)n >= sizeof(line)) {
+        n = sizeof(line) - 1;
+    }
+    return shard_append_data(shard, line, (size_t)n);
+}
+
+/* Append one path to the scan queue (single-threaded collection phase) */
+static int scan_queue_add(ScanQueue *queue, const char *path) {
+    if (queue->count == queue->capacity) {
+        size_t new_cap = queue->capacity ? queue->capacity * 2 : 64;
+        char **grown = realloc(queue->paths, new_cap * sizeof(char *));
+        if (!grown) {
+            return 1;
+        }
+        queue->paths = grown;
+        queue->capacity = new_cap;
+    }
+    queue->paths[queue->count] = strdup(path);
+    if (!queue->paths[queue->count]) {
+        return 1;
+    }
+    queue->count++;
+    return 0;
+}
+
+/* Case-insensitive check for a .xex file extension */
+static int has_xex_extension(const char *name) {
+    size_t len = strlen(name);
+    if (len < 4) {
+        return 0;
+    }
+    const char *ext = name + len - 4;
+    return ext[0] == '.' &&
+           (ext[1] == 'x' || ext[1] == 'X') &&
+           (ext[2] == 'e' || ext[2] == 'E') &&
+           (ext[3] == 'x' || ext[3] == 'X');
+}
+
+/* Recursively collect .xex files under dir into the queue */
+static int scan_collect(ScanQueue *queue, const char *dir) {
+    DIR *dp = opendir(dir);
+    if (!dp) {
+        fprintf(stderr, "ERROR: Cannot open directory '%s'\n", dir);
+        return 1;
+    }
+
+    struct dirent *entry;
+    int ret = 0;
+    while ((entry = readdir(dp)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            ret |= scan_collect(queue, path);
+        } else if (S_ISREG(st.st_mode) && has_xex_extension(entry->d_name)) {
+            if (scan_queue_add(queue, path) != 0) {
+                ret = 1;
+                break;
+            }
+        }
+    }
+
+    closedir(dp);
+    return ret;
+}
+
+/* Record one file's parse outcome in a worker's private shard */
+static void scan_count_result(ScanShard *shard, int failed, const XexParsed *parsed) {
+    if (failed) {
+        shard->invalid++;
+        return;
+    }
+    shard->analyzed++;
+    if (parsed->has_file_format_info) {
+        if (parsed->encryption_type == XEX_ENCRYPTION_NORMAL) {
+            shard->encrypted++;
+        }
+        if (parsed->compression_type < 4) {
+            shard->compression_counts[parsed->compression_type]++;
+        } else {
+            shard->compression_other++;
+        }
+    }
+}
+
+/*
+ * ---- io_uring scan backend ----
+ *
+ * The synchronous scan path issues one open/read/close per file and
+ * leaves the device queue nearly empty.  This backend drives the scan
+ * through io_uring instead, keeping a batch of opens in flight, then a
+ * batch of header reads, so a single thread can saturate the device.
+ * The headers are parsed straight out of the read buffers; files whose
+ * header table spills past the buffer (or kernels without io_uring)
+ * fall back to the synchronous path.
+ */
+
+/* Raw syscall wrappers: the backend has no liburing dependency */
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+/* In-flight requests per batch and bytes read per file */
+#define URING_QUEUE_DEPTH 64
+#define URING_READ_SIZE 4096
+
+/* One mapped io_uring instance */
+typedef struct {
+    int fd;
+    struct io_uring_params params;
+    /* Submission ring */
+    uint8_t *sq_ring;
+    size_t sq_ring_size;
+    uint32_t *sq_tail;
+    uint32_t *sq_mask;
+    uint32_t *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    uint32_t sqe_next;
+    /* Completion ring */
+    uint8_t *cq_ring;
+    size_t cq_ring_size;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t *cq_mask;
+    struct io_uring_cqe *cqes;
+} Uring;
+
+static int uring_init(Uring *u) {
+    memset(u, 0, sizeof(*u));
+    u->fd = (int)syscall(SYS_io_uring_setup, URING_QUEUE_DEPTH, &u->params);
+    if (u->fd < 0) {
+        return 1;
+    }
+
+    u->sq_ring_size = u->params.sq_off.array +
+                      u->params.sq_entries * sizeof(uint32_t);
+    u->cq_ring_size = u->params.cq_off.cqes +
+                      u->params.cq_entries * sizeof(struct io_uring_cqe);
+
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED) {
+        close(u->fd);
+        return 1;
+    }
+
+    if (u->params.features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ring = u->sq_ring;
+    } else {
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, u->fd,
+                          IORING_OFF_CQ_RING);
+        if (u->cq_ring == MAP_FAILED) {
+            munmap(u->sq_ring, u->sq_ring_size);
+            close(u->fd);
+            return 1;
+        }
+    }
+
+    u->sqes_size = u->params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        if (u->cq_ring != u->sq_ring) {
+            munmap(u->cq_ring, u->cq_ring_size);
+        }
+        munmap(u->sq_ring, u->sq_ring_size);
+        close(u->fd);
+        return 1;
+    }
+
+    u->sq_tail = (uint32_t *)(u->sq_ring + u->params.sq_off.tail);
+    u->sq_mask = (uint32_t *)(u->sq_ring + u->params.sq_off.ring_mask);
+    u->sq_array = (uint32_t *)(u->sq_ring + u->params.sq_off.array);
+    u->cq_head = (uint32_t *)(u->cq_ring + u->params.cq_off.head);
+    u->cq_tail = (uint32_t *)(u->cq_ring + u->params.cq_off.tail);
+    u->cq_mask = (uint32_t *)(u->cq_ring + u->params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(u->cq_ring + u->params.cq_off.cqes);
+    return 0;
+}
+
+static void uring_close(Uring *u) {
+    munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != u->sq_ring) {
+        munmap(u->cq_ring, u->cq_ring_size);
+    }
+    munmap(u->sq_ring, u->sq_ring_size);
+    close(u->fd);
+}
+
+/* Queue one SQE (caller stays within the ring size per batch) */
+static struct io_uring_sqe *uring_get_sqe(Uring *u) {
+    uint32_t tail = *u->sq_tail;
+    uint32_t index = u->sqe_next++ & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[tail & *u->sq_mask] = index;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+/* Submit everything queued and wait for that many completions */
+static int uring_submit_wait(Uring *u, unsigned count) {
+    int ret = (int)syscall(SYS_io_uring_enter, u->fd, count, count,
+                           IORING_ENTER_GETEVENTS, NULL, 0);
+    return (ret < 0) ? 1 : 0;
+}
+
+/* Pop one completion; returns 0 when the ring is empty */
+static int uring_pop_cqe(Uring *u, uint64_t *user_data, int32_t *res) {
+    uint32_t head = *u->cq_head;
+    if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    const struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+    *user_data = cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* Parse one header buffer and record/print the result (same output as
+ * the synchronous path) */
+static void scan_report_buffer(ScanShard *shard, const char *path,
+                               const uint8_t *buf, size_t len) {
+    XexView view;
+    XexArena arena;
+    XexParsed parsed;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+
+    view.data = buf;
+    view.size = len;
+    view.is_mapped = 0;
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    int status = xex_parse(&view, &arena, &parsed);
+    if (status == XEX_ERR_TRUNCATED && len == URING_READ_SIZE) {
+        /* Headers spill past the read buffer: take the full sync path */
+        size_t file_size;
+        status = get_parsed(path, &arena, &parsed, &file_size);
+    }
+    int failed = (status != XEX_OK);
+
+    scan_count_result(shard, failed, &parsed);
+    if (failed) {
+        printf("%s: INVALID\n", path);
+    } else if (parsed.has_file_format_info) {
+        printf("%s: encryption=%s compression=%s headers=%u\n", path,
+               get_encryption_name(parsed.encryption_type),
+               get_compression_name(parsed.compression_type),
+               parsed.opt_count);
+    } else {
+        printf("%s: encryption=unknown compression=unknown headers=%u\n",
+               path, parsed.opt_count);
+    }
+    xex_arena_release(&arena);
+}
+
+/* Drive the whole queue through io_uring in open/read batches */
+static int scan_uring_run(ScanQueue *queue, ScanShard *shard) {
+    Uring ring;
+    if (uring_init(&ring) != 0) {
+        return 1;    /* Fall back to the synchronous pool */
+    }
+
+    static uint8_t buffers[URING_QUEUE_DEPTH][URING_READ_SIZE];
+    int fds[URING_QUEUE_DEPTH];
+    int32_t read_len[URING_QUEUE_DEPTH];
+
+    for (size_t base = 0; base < queue->count; base += URING_QUEUE_DEPTH) {
+        size_t batch = queue->count - base;
+        if (batch > URING_QUEUE_DEPTH) {
+            batch = URING_QUEUE_DEPTH;
+        }
+
+        /* Phase 1: all opens in flight at once */
+        for (size_t i = 0; i < batch; i++) {
+            struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)(uintptr_t)queue->paths[base + i];
+            sqe->open_flags = O_RDONLY;
+            sqe->user_data = i;
+            fds[i] = -1;
+        }
+        if (uring_submit_wait(&ring, (unsigned)batch) != 0) {
+            uring_close(&ring);
+            return 1;
+        }
+        uint64_t user_data;
+        int32_t res;
+        while (uring_pop_cqe(&ring, &user_data, &res)) {
+            fds[user_data] = res;
+        }
+
+        /* Phase 2: all header reads in flight at once */
+        unsigned reads = 0;
+        for (size_t i = 0; i < batch; i++) {
+            read_len[i] = -1;
+            if (fds[i] < 0) {
+                continue;
+            }
+            struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fds[i];
+            sqe->addr = (uint64_t)(uintptr_t)buffers[i];
+            sqe->len = URING_READ_SIZE;
+            sqe->user_data = i;
+            reads++;
+        }
+        if (reads > 0 && uring_submit_wait(&ring, reads) != 0) {
+            for (size_t i = 0; i < batch; i++) {
+                if (fds[i] >= 0) {
+                    close(fds[i]);
+                }
+            }
+            uring_close(&ring);
+            return 1;
+        }
+        while (uring_pop_cqe(&ring, &user_data, &res)) {
+            read_len[user_data] = res;
+        }
+
+        /* Phase 3: parse and report from the buffers */
+        for (size_t i = 0; i < batch; i++) {
+            const char *path = queue->paths[base + i];
+            if (fds[i] < 0 || read_len[i] < 0) {
+                shard->invalid++;
+                printf("%s: INVALID\n", path);
+            } else {
+                scan_report_buffer(shard, path, buffers[i],
+                                   (size_t)read_len[i]);
+            }
+            if (fds[i] >= 0) {
+                close(fds[i]);
+            }
+        }
+    }
+
+    uring_close(&ring);
+    return 0;
+}
+
+/* Arguments for one scan worker: the shared queue plus its shard */
+typedef struct {
+    ScanQueue *queue;
+    ScanShard *shard;
+} ScanWorkerArgs;
+
+/* Worker thread: claim paths from the queue until it is drained.
+ * Results go to the worker's private shard - no lock, no shared
+ * cache line, no stdout contention on the hot path. */
+static void *scan_worker(void *arg) {
+    ScanWorkerArgs *wa = (ScanWorkerArgs *)arg;
+    ScanQueue *queue = wa->queue;
+    ScanShard *shard = wa->shard;
+
+    for (;;) {
+        size_t index = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED);
+        if (index >= queue->count) {
+            break;
+        }
+
+        const char *path = queue->paths[index];
+        XexArena arena;
+        XexParsed parsed;
+        size_t file_size;
+        uint8_t arena_buf[PARSE_ARENA_SIZE];
+
+        xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+        int failed = (get_parsed(path, &arena, &parsed, &file_size) != XEX_OK);
+
+        /* JSON mode: emit the NDJSON record instead of a text line */
+        JsonBuf jb;
+        int have_json = 0;
+        if (json_mode && !failed) {
+            have_json = (xex_format_json(path, &jb) == 0);
+        }
+
+        scan_count_result(shard, failed, &parsed);
+        if (json_mode) {
+            if (have_json) {
+                shard_append_data(shard, jb.buf, jb.len);
+            }
+        } else if (failed) {
+            shard_append(shard, "%s: INVALID\n", path);
+        } else if (parsed.has_file_format_info) {
+            shard_append(shard, "%s: encryption=%s compression=%s headers=%u\n",
+                         path, get_encryption_name(parsed.encryption_type),
+                         get_compression_name(parsed.compression_type),
+                         parsed.opt_count);
+        } else {
+            shard_append(shard,
+                         "%s: encryption=unknown compression=unknown headers=%u\n",
+                         path, parsed.opt_count);
+        }
+        xex_arena_release(&arena);
+    }
+
+    return NULL;
+}
+
+/* Scan a directory tree for XEX files using a pool of worker threads */
+static int scan_directory(const char *dir, int thread_count) {
+    ScanQueue queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (scan_collect(&queue, dir) != 0 && queue.count == 0) {
+        return 1;
+    }
+
+    /* Text scans without a cache go through io_uring when the kernel
+     * has it: batched opens and header reads from a single thread.
+     * JSON, cached and instrumented scans (and older kernels) use the
+     * thread pool. */
+    ScanShard *shards = NULL;
+    int shard_count = 0;
+    int scanned = 0;
+    if (!json_mode && !cache_dir && !stats_mode) {
+        shards = calloc(1, sizeof(ScanShard));
+        if (!shards) {
+            fprintf(stderr, "ERROR: Out of memory\n");
+            return 1;
+        }
+        shard_count = 1;
+        scanned = (scan_uring_run(&queue, &shards[0]) == 0);
+    }
+
+    if (!scanned) {
+        if (thread_count <= 0) {
+            long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+            thread_count = (ncpu > 0) ? (int)ncpu : 1;
+        }
+        if ((size_t)thread_count > queue.count && queue.count > 0) {
+            thread_count = (int)queue.count;
+        }
+
+        /* One shard per worker; the uring shard (if any) is replaced */
+        free(shards);
+        shards = calloc((size_t)thread_count, sizeof(ScanShard));
+        pthread_t *threads = calloc((size_t)thread_count, sizeof(pthread_t));
+        ScanWorkerArgs *args = calloc((size_t)thread_count, sizeof(ScanWorkerArgs));
+        if (!shards || !threads || !args) {
+            fprintf(stderr, "ERROR: Out of memory\n");
+            free(shards);
+            free(threads);
+            free(args);
+            return 1;
+        }
+        shard_count = thread_count;
+        for (int i = 0; i < thread_count; i++) {
+            args[i].queue = &queue;
+            args[i].shard = &shards[i];
+            pthread_create(&threads[i], NULL, scan_worker, &args[i]);
+        }
+        for (int i = 0; i < thread_count; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        free(args);
+    }
+
+    /* Merge: flush the buffered reports in shard order, sum counters */
+    ScanShard total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < shard_count; i++) {
+        if (shards[i].out_len > 0) {
+            fwrite(shards[i].out, 1, shards[i].out_len, stdout);
+        }
+        free(shards[i].out);
+        total.analyzed += shards[i].analyzed;
+        total.invalid += shards[i].invalid;
+        total.encrypted += shards[i].encrypted;
+        for (int c = 0; c < 4; c++) {
+            total.compression_counts[c] += shards[i].compression_counts[c];
+        }
+        total.compression_other += shards[i].compression_other;
+    }
+    free(shards);
+
+    if (json_mode) {
+        goto cleanup;
+    }
+
+    printf("\n=== Scan Summary ===\n");
+    printf("Files found:       %zu\n", queue.count);
+    printf("Analyzed:          %zu\n", total.analyzed);
+    printf("Invalid:           %zu\n", total.invalid);
+    printf("Encrypted:         %zu\n", total.encrypted);
+    printf("Compression none:  %zu\n", total.compression_counts[XEX_COMPRESSION_NONE]);
+    printf("Compression basic: %zu\n", total.compression_counts[XEX_COMPRESSION_BASIC]);
+    printf("Compression normal: %zu\n", total.compression_counts[XEX_COMPRESSION_NORMAL]);
+    printf("Compression delta: %zu\n", total.compression_counts[XEX_COMPRESSION_DELTA]);
+    if (total.compression_other > 0) {
+        printf("Compression other: %zu\n", total.compression_other);
+    }
+
+cleanup:
+    for (size_t i = 0; i < queue.count; i++) {
+        free(queue.paths[i]);
+    }
+    free(queue.paths);
+    return 0;
+}
+
+/*
+ * ---- Incremental scan ----
+ *
+ * --scan --incremental <manifest> re-analyzes only what changed since
+ * the previous run.  The manifest records each file's identity (size,
+ * mtime, header digest) next to its analysis outcome; on the next run
+ * files whose identity still matches are reported straight from the
+ * manifest and only new or modified files go through the parser.  The
+ * merged result set - same lines, same summary - is emitted either
+ * way, and the manifest is rewritten atomically for the next night.
+ */
+
+/* One analysis outcome, small enough to persist per corpus file */
+typedef struct {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    char digest[SHA1_DIGEST_SIZE * 2 + 1];  /* Header page, hex */
+    int failed;
+    int has_ffi;
+    unsigned encryption;
+    unsigned compression;
+    unsigned opt_count;
+    int reused;                /* Carried over from the manifest */
+} ScanResult;
+
+/* Shared state for the incremental workers */
+typedef struct {
+    ScanQueue *queue;
+    ScanResult *results;
+} IncrementalArgs;
+
+/* FNV-1a hash of a path, for the manifest match index */
+static uint32_t manifest_hash(const char *s) {
+    uint32_t hash = 2166136261u;
+    for (; *s; s++) {
+        hash ^= (unsigned char)*s;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Load a manifest; returns entries matched against queue paths by
+ * filling results[i] for files whose identity is unchanged */
+static size_t manifest_load(const char *manifest_path, const ScanQueue *queue,
+                            ScanResult *results) {
+    FILE *in = fopen(manifest_path, "r");
+    if (!in) {
+        return 0;    /* First run: analyze everything */
+    }
+
+    char line[8192];
+    if (!fgets(line, sizeof(line), in) ||
+        strncmp(line, "XEXMANIFEST 1", 13) != 0) {
+        fclose(in);
+        return 0;
+    }
+
+    /* Path index over the queue: open addressing, power-of-two
+     * buckets, -1 = empty - each manifest line is one probe instead
+     * of a strcmp against every collected path */
+    uint32_t buckets = 8;
+    while (buckets < queue->count * 2) {
+        buckets <<= 1;
+    }
+    int32_t *index = malloc(buckets * sizeof(int32_t));
+    if (!index) {
+        fclose(in);
+        return 0;
+    }
+    memset(index, 0xFF, buckets * sizeof(int32_t));
+    for (size_t i = 0; i < queue->count; i++) {
+        uint32_t slot = manifest_hash(queue->paths[i]) & (buckets - 1);
+        while (index[slot] >= 0) {
+            slot = (slot + 1) & (buckets - 1);
+        }
+        index[slot] = (int32_t)i;
+    }
+
+    size_t reused = 0;
+    while (fgets(line, sizeof(line), in)) {
+        ScanResult rec;
+        memset(&rec, 0, sizeof(rec));
+        int path_at = 0;
+        if (sscanf(line, "%llu %lld %lld %40s %d %d %u %u %u %n",
+                   (unsigned long long *)&rec.size,
+                   (long long *)&rec.mtime_sec,
+                   (long long *)&rec.mtime_nsec,
+                   rec.digest, &rec.failed, &rec.has_ffi,
+                   &rec.encryption, &rec.compression, &rec.opt_count,
+                   &path_at) != 9 || path_at == 0) {
+            continue;
+        }
+        char *path = line + path_at;
+        path[strcspn(path, "\n")] = '\0';
+
+        /* Match against the collected paths and the live identity */
+        uint32_t slot = manifest_hash(path) & (buckets - 1);
+        while (index[slot] >= 0) {
+            size_t i = (size_t)index[slot];
+            if (strcmp(queue->paths[i], path) == 0) {
+                struct stat st;
+                if (stat(path, &st) == 0 &&
+                    (uint64_t)st.st_size == rec.size &&
+                    (int64_t)st.st_mtim.tv_sec == rec.mtime_sec &&
+                    (int64_t)st.st_mtim.tv_nsec == rec.mtime_nsec) {
+                    results[i] = rec;
+                    results[i].reused = 1;
+                    reused++;
+                }
+                break;
+            }
+            slot = (slot + 1) & (buckets - 1);
+        }
+    }
+
+    free(index);
+    fclose(in);
+    return reused;
+}
+
+/* Worker: analyze only the queue entries with no reusable result */
+static void *incremental_worker(void *arg) {
+    IncrementalArgs *ia = (IncrementalArgs *)arg;
+    ScanQueue *queue = ia->queue;
+
+    for (;;) {
+        size_t index = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED);
+        if (index >= queue->count) {
+            break;
+        }
+        ScanResult *res = &ia->results[index];
+        if (res->reused) {
+            continue;
+        }
+
+        const char *path = queue->paths[index];
+        struct stat st;
+        if (stat(path, &st) == 0) {
+            res->size = (uint64_t)st.st_size;
+            res->mtime_sec = (int64_t)st.st_mtim.tv_sec;
+            res->mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+        }
+
+        XexArena arena;
+        XexParsed parsed;
+        size_t file_size;
+        uint8_t arena_buf[PARSE_ARENA_SIZE];
+        xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+        res->failed = (get_parsed(path, &arena, &parsed, &file_size) != XEX_OK);
+        if (!res->failed) {
+            res->has_ffi = parsed.has_file_format_info;
+            res->encryption = parsed.encryption_type;
+            res->compression = parsed.compression_type;
+            res->opt_count = parsed.opt_count;
+        }
+        xex_arena_release(&arena);
+
+        /* Header-page digest, for audits of the manifest itself */
+        XexView view;
+        if (xex_view_open(path, &view, use_mmap) == XEX_OK) {
+            uint8_t digest[SHA1_DIGEST_SIZE];
+            size_t n = view.size < 4096 ? view.size : 4096;
+            sha1(view.data, n, digest);
+            digest_to_hex(digest, res->digest);
+            xex_view_close(&view);
+        } else {
+            strcpy(res->digest, "-");
+        }
+    }
+    return NULL;
+}
+
+/* Emit one scan report line from a stored or fresh result */
+static void incremental_report(const char *path, const ScanResult *res) {
+    if (res->failed) {
+        printf("%s: INVALID\n", path);
+    } else if (res->has_ffi) {
+        printf("%s: encryption=%s compression=%s headers=%u\n", path,
+               get_encryption_name((uint16_t)res->encryption),
+               get_compression_name((uint16_t)res->compression),
+               res->opt_count);
+    } else {
+        printf("%s: encryption=unknown compression=unknown headers=%u\n",
+               path, res->opt_count);
+    }
+}
+
+/* Incremental scan: manifest diff, analyze the changed files, merge */
+static int scan_incremental(const char *dir, const char *manifest_path,
+                            int thread_count) {
+    ScanQueue queue;
+    memset(&queue, 0, sizeof(queue));
+    if (scan_collect(&queue, dir) != 0 && queue.count == 0) {
+        return 1;
+    }
+
+    ScanResult *results = calloc(queue.count ? queue.count : 1,
+                                 sizeof(ScanResult));
+    if (!results) {
+        fprintf(stderr, "ERROR: Out of memory\n");
+        return 1;
+    }
+
+    size_t reused = manifest_load(manifest_path, &queue, results);
+
+    if (thread_count <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (ncpu > 0) ? (int)ncpu : 1;
+    }
+    if ((size_t)thread_count > queue.count && queue.count > 0) {
+        thread_count = (int)queue.count;
+    }
+
+    IncrementalArgs ia = { &queue, results };
+    pthread_t threads[64];
+    if (thread_count > 64) {
+        thread_count = 64;
+    }
+    for (int i = 0; i < thread_count; i++) {
+        pthread_create(&threads[i], NULL, incremental_worker, &ia);
+    }
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /* Merged result set: stored and fresh lines, then the summary */
+    ScanShard total;
+    memset(&total, 0, sizeof(total));
+    for (size_t i = 0; i < queue.count; i++) {
+        incremental_report(queue.paths[i], &results[i]);
+        if (results[i].failed) {
+            total.invalid++;
+            continue;
+        }
+        total.analyzed++;
+        if (results[i].has_ffi) {
+            if (results[i].encryption == XEX_ENCRYPTION_NORMAL) {
+                total.encrypted++;
+            }
+            if (results[i].compression < 4) {
+                total.compression_counts[results[i].compression]++;
+            } else {
+                total.compression_other++;
+            }
+        }
+    }
+
+    printf("\n=== Scan Summary ===\n");
+    printf("Files found:       %zu\n", queue.count);
+    printf("Reused:            %zu\n", reused);
+    printf("Re-analyzed:       %zu\n", queue.count - reused);
+    printf("Analyzed:          %zu\n", total.analyzed);
+    printf("Invalid:           %zu\n", total.invalid);
+    printf("Encrypted:         %zu\n", total.encrypted);
+    printf("Compression none:  %zu\n", total.compression_counts[XEX_COMPRESSION_NONE]);
+    printf("Compression basic: %zu\n", total.compression_counts[XEX_COMPRESSION_BASIC]);
+    printf("Compression normal: %zu\n", total.compression_counts[XEX_COMPRESSION_NORMAL]);
+    printf("Compression delta: %zu\n", total.compression_counts[XEX_COMPRESSION_DELTA]);
+    if (total.compression_other > 0) {
+        printf("Compression other: %zu\n", total.compression_other);
+    }
+
+    /* Rewrite the manifest atomically for the next run */
+    char temp_path[4096];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp.%d", manifest_path,
+             (int)getpid());
+    FILE *out = fopen(temp_path, "w");
+    int ret = 0;
+    if (out) {
+        fprintf(out, "XEXMANIFEST 1\n");
+        for (size_t i = 0; i < queue.count; i++) {
+            const ScanResult *r = &results[i];
+            fprintf(out, "%llu %lld %lld %s %d %d %u %u %u %s\n",
+                    (unsigned long long)r->size,
+                    (long long)r->mtime_sec, (long long)r->mtime_nsec,
+                    r->digest[0] ? r->digest : "-",
+                    r->failed, r->has_ffi, r->encryption, r->compression,
+                    r->opt_count, queue.paths[i]);
+        }
+        if (fclose(out) != 0 || rename(temp_path, manifest_path) != 0) {
+            unlink(temp_path);
+            ret = 1;
+        }
+    } else {
+        fprintf(stderr, "ERROR: Cannot write manifest '%s'\n", manifest_path);
+        ret = 1;
+    }
+
+    free(results);
+    for (size_t i = 0; i < queue.count; i++) {
+        free(queue.paths[i]);
+    }
+    free(queue.paths);
+    return ret;
+}
+
+/*
+ * ---- Fast-path check mode ----
+ *
+ * --check answers one question ("is this image encrypted?", "is it
+ * compressed?", "does its security info pass validation?") through the
+ * exit code alone: 0 = yes/accept, 1 = no/reject, 2 = error.  It
+ * parses lazily - header, then only the fields the question needs -
+ * and prints nothing, since stdout formatting dominates the wall time
+ * of the full analysis when this runs thousands of times in a CI gate.
+ */
+static int check_mode_run(const char *filename, const char *what) {
+    XexView view;
+    if (xex_view_open(filename, &view, use_mmap) != XEX_OK ||
+        view.size < sizeof(XEX2_Header)) {
+        return 2;
+    }
+
+    const XEX2_Header *header = (const XEX2_Header *)view.data;
+    if (be32_to_cpu(header->magic) != XEX2_MAGIC) {
+        xex_view_close(&view);
+        return 2;
+    }
+
+    /* The security gate needs only the fixed header fields, not the
+     * optional header table */
+    if (strcmp(what, "security") == 0) {
+        XexParsed stub;
+        memset(&stub, 0, sizeof(stub));
+        stub.pe_offset = be32_to_cpu(header->pe_offset);
+        stub.security_offset = be32_to_cpu(header->security_offset);
+
+        XexSecurityInfo sec;
+        int accept = xex_parse_security(&view, &stub, &sec) == XEX_OK &&
+                     xex_security_validate(&view, &stub, &sec) == XEX_OK;
+        xex_view_close(&view);
+        return accept ? 0 : 1;
+    }
+
+    /* Scan the table only until FILE_FORMAT_INFO is found */
+    uint32_t opt_count = be32_to_cpu(header->optional_header_count);
+    const uint8_t *table = view.data + sizeof(XEX2_Header);
+    size_t opt_avail = (view.size - sizeof(XEX2_Header)) / sizeof(XexOptHeader);
+    uint32_t ffi_offset = 0;
+
+    for (uint32_t i = 0; i < opt_count && i < opt_avail; i++) {
+        uint32_t key;
+        memcpy(&key, table + i * sizeof(XexOptHeader), 4);
+        if (be32_to_cpu(key) == XEX_HEADER_FILE_FORMAT_INFO) {
+            uint32_t value;
+            memcpy(&value, table + i * sizeof(XexOptHeader) + 4, 4);
+            ffi_offset = be32_to_cpu(value);
+            break;
+        }
+    }
+
+    if (ffi_offset == 0 ||
+        (size_t)ffi_offset + sizeof(FileFormatInfo) > view.size) {
+        xex_view_close(&view);
+        return 2;
+    }
+
+    const FileFormatInfo *ffi = (const FileFormatInfo *)(view.data + ffi_offset);
+    int result;
+    if (strcmp(what, "encryption") == 0) {
+        result = (be16_to_cpu(ffi->encryption_type) != XEX_ENCRYPTION_NONE) ? 0 : 1;
+    } else if (strcmp(what, "compression") == 0) {
+        result = (be16_to_cpu(ffi->compression_type) != XEX_COMPRESSION_NONE) ? 0 : 1;
+    } else {
+        result = 2;
+    }
+
+    xex_view_close(&view);
+    return result;
+}
+
+/*
+ * ---- Daemon mode ----
+ *
+ * --daemon binds a Unix domain socket and services analysis requests
+ * from a persistent process: clients write one file path per line and
+ * read back the same NDJSON record --json would print.  Each
+ * connection is handled by its own thread, so a driver can stream
+ * thousands of requests over one connection (or several in parallel)
+ * with no per-file exec cost, and the analysis cache plus the kernel
+ * page cache stay warm across requests.
+ */
+
+/* Serve one client connection: a path per line in, NDJSON out */
+static void *daemon_client(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    FILE *in = fdopen(fd, "r");
+    if (!in) {
+        close(fd);
+        return NULL;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+
+        JsonBuf jb;
+        if (xex_format_json(line, &jb) != 0) {
+            /* Unreadable path: report it in-band so the stream stays
+             * one record per request */
+            jb.len = 0;
+            jb.overflow = 0;
+            json_append(&jb, "{\"file\":");
+            json_append_string(&jb, line);
+            json_append(&jb, ",\"error\":\"cannot open\"}\n");
+        }
+        if (write(fd, jb.buf, jb.len) != (ssize_t)jb.len) {
+            break;
+        }
+    }
+
+    fclose(in);
+    return NULL;
+}
+
+/* Accept loop: one detached thread per connection */
+static int daemon_run(const char *socket_path) {
+    /* A client hanging up mid-reply must not kill the daemon */
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        fprintf(stderr, "ERROR: Cannot create socket\n");
+        return 1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "ERROR: Socket path too long\n");
+        close(listen_fd);
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd, 64) != 0) {
+        fprintf(stderr, "ERROR: Cannot bind socket '%s'\n", socket_path);
+        close(listen_fd);
+        return 1;
+    }
+
+    fprintf(stderr, "xextool daemon listening on %s\n", socket_path);
+
+    for (;;) {
+        int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, daemon_client,
+                           (void *)(intptr_t)client_fd) != 0) {
+            close(client_fd);
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    return 0;
+}
+
+/*
+ * ---- Parallel image verification ----
+ *
+ * --verify checks a decrypted basefile against the page-hash chain in
+ * the security info block.  The page descriptors after the fixed
+ * security fields each name a run of image pages and carry the SHA-1
+ * of the NEXT run's data concatenated with the next raw descriptor;
+ * the security-info image digest anchors the chain by covering the
+ * first run plus the first descriptor.  Every link is independent
+ * once the descriptor table is in hand, so workers verify links in
+ * parallel (SHA-NI when available).  Runs containing import fixup
+ * targets are hashed by the image builder before its fixup pass
+ * rewrites them, so their data cannot compare equal; those links are
+ * skipped and reported separately, while their descriptors remain
+ * authenticated through the chain.
+ */
+
+/* One raw page descriptor: 4-byte size_info plus the digest */
+#define VERIFY_DESCRIPTOR_SIZE (4 + SHA1_DIGEST_SIZE)
+
+/* One hash-chain link: a page run plus the descriptor appended to it */
+typedef struct {
+    size_t offset;               /* Image offset of the covered run */
+    size_t size;
+    const uint8_t *expected;     /* Digest this link must produce */
+    const uint8_t *descriptor;   /* Raw descriptor hashed after the run */
+    int fixup;                   /* Run holds import fixup targets */
+    int mismatch;
+} VerifyLink;
+
+/* Shared state for the verify workers */
+typedef struct {
+    const uint8_t *image;
+    VerifyLink *links;
+    size_t link_count;
+    size_t next;                /* Next unclaimed link */
+    pthread_mutex_t lock;
+} VerifyJob;
+
+/* Worker thread: verify chain links until the job is drained */
+static void *verify_worker(void *arg) {
+    VerifyJob *job = (VerifyJob *)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        size_t index = job->next;
+        if (index >= job->link_count) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        VerifyLink *link = &job->links[index];
+        if (link->fixup) {
+            continue;
+        }
+
+        Sha1Ctx ctx;
+        uint8_t digest[SHA1_DIGEST_SIZE];
+        sha1_init(&ctx);
+        sha1_update(&ctx, job->image + link->offset, link->size);
+        sha1_update(&ctx, link->descriptor, VERIFY_DESCRIPTOR_SIZE);
+        sha1_final(&ctx, digest);
+        link->mismatch = memcmp(digest, link->expected, SHA1_DIGEST_SIZE) != 0;
+    }
+
+    return NULL;
+}
+
+/* Format a digest as lowercase hex */
+static void digest_to_hex(const uint8_t digest[SHA1_DIGEST_SIZE],
+                          char out[SHA1_DIGEST_SIZE * 2 + 1]) {
+    for (int i = 0; i < SHA1_DIGEST_SIZE; i++) {
+        sprintf(out + i * 2, "%02x", digest[i]);
+    }
+}
+
+/* Verify a decrypted image against the XEX page-hash chain */
+static int verify_image(const char *xex_path, const char *image_path,
+                        int thread_count) {
+    XexView xex_view;
+    XexArena arena;
+    XexParsed parsed;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    if (open_and_parse(xex_path, &xex_view, &arena, &parsed) != XEX_OK) {
+        return 2;
+    }
+
+    XexSecurityInfo sec;
+    if (xex_parse_security(&xex_view, &parsed, &sec) != XEX_OK ||
+        xex_security_validate(&xex_view, &parsed, &sec) != XEX_OK) {
+        fprintf(stderr, "ERROR: Security info block fails validation\n");
+        goto fail_xex;
+    }
+
+    /* The page descriptor table follows the fixed security fields:
+     * a count, then {size_info, digest} entries */
+    size_t table = (size_t)parsed.security_offset + XEX_SECURITY_INFO_SIZE;
+    size_t sec_end = (size_t)parsed.security_offset + sec.header_size;
+    uint32_t desc_count = 0;
+    if (table + 4 <= sec_end) {
+        memcpy(&desc_count, xex_view.data + table, 4);
+        desc_count = be32_to_cpu(desc_count);
+    }
+    const uint8_t *descs = xex_view.data + table + 4;
+    if (desc_count == 0 ||
+        table + 4 + (size_t)desc_count * VERIFY_DESCRIPTOR_SIZE > sec_end) {
+        fprintf(stderr, "ERROR: Page descriptor table is truncated\n");
+        goto fail_xex;
+    }
+
+    /* Page size falls out of the descriptor page counts */
+    uint64_t total_pages = 0;
+    for (uint32_t i = 0; i < desc_count; i++) {
+        uint32_t size_info;
+        memcpy(&size_info, descs + (size_t)i * VERIFY_DESCRIPTOR_SIZE, 4);
+        total_pages += be32_to_cpu(size_info) >> 4;
+    }
+    if (total_pages == 0 || sec.image_size % total_pages != 0 ||
+        (sec.image_size / total_pages) % 4096 != 0) {
+        fprintf(stderr, "ERROR: Page descriptors do not cover the image\n");
+        goto fail_xex;
+    }
+    size_t page_size = sec.image_size / total_pages;
+
+    XexView image;
+    if (xex_view_open(image_path, &image, use_mmap) != XEX_OK) {
+        fprintf(stderr, "ERROR: Cannot open image '%s'\n", image_path);
+        goto fail_xex;
+    }
+
+    printf("Image:         %s (%zu bytes)\n", image_path, image.size);
+    printf("Expected size: %u bytes\n", sec.image_size);
+    printf("Chain links:   %u (%zu-byte pages)\n", desc_count, page_size);
+
+    if (image.size != sec.image_size) {
+        printf("Result:        SIZE MISMATCH\n");
+        xex_view_close(&image);
+        xex_view_close(&xex_view);
+        xex_arena_release(&arena);
+        return 1;
+    }
+
+    /* Build the links: link i covers run i, checked against the
+     * previous descriptor's digest (the security-info image digest
+     * for the first run) */
+    VerifyLink *links = calloc(desc_count, sizeof(VerifyLink));
+    if (!links) {
+        fprintf(stderr, "ERROR: Out of memory\n");
+        xex_view_close(&image);
+        goto fail_xex;
+    }
+    size_t run_offset = 0;
+    for (uint32_t i = 0; i < desc_count; i++) {
+        const uint8_t *desc = descs + (size_t)i * VERIFY_DESCRIPTOR_SIZE;
+        uint32_t size_info;
+        memcpy(&size_info, desc, 4);
+        links[i].offset = run_offset;
+        links[i].size = (size_t)(be32_to_cpu(size_info) >> 4) * page_size;
+        links[i].descriptor = desc;
+        links[i].expected = (i == 0)
+            ? sec.image_digest
+            : desc - VERIFY_DESCRIPTOR_SIZE + 4;
+        run_offset += links[i].size;
+    }
+
+    /* Mark runs containing import fixup targets; the builder hashed
+     * them before the fixup pass rewrote the slots and thunks */
+    size_t fixup_count = 0;
+    {
+        XexArena import_arena;
+        XexImportTable imports;
+        uint8_t *import_buf = malloc(IMPORT_ARENA_SIZE);
+        if (import_buf) {
+            xex_arena_init(&import_arena, import_buf, IMPORT_ARENA_SIZE);
+            if (xex_parse_imports(&xex_view, &parsed, &import_arena,
+                                  &imports) == XEX_OK) {
+                for (uint32_t l = 0; l < imports.library_count; l++) {
+                    const XexImportLibrary *lib = &imports.libraries[l];
+                    for (uint32_t r = 0; r < lib->record_count; r++) {
+                        size_t rel = lib->records[r] - sec.load_address;
+                        for (uint32_t i = 0; i < desc_count; i++) {
+                            if (rel >= links[i].offset &&
+                                rel < links[i].offset + links[i].size) {
+                                if (!links[i].fixup) {
+                                    links[i].fixup = 1;
+                                    fixup_count++;
+                                }
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            xex_arena_release(&import_arena);
+            free(import_buf);
+        }
+    }
+
+    /* Verify the links in parallel */
+    VerifyJob job;
+    job.image = image.data;
+    job.links = links;
+    job.link_count = desc_count;
+    job.next = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    if (thread_count <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (ncpu > 0) ? (int)ncpu : 1;
+    }
+    if ((size_t)thread_count > (size_t)desc_count) {
+        thread_count = (int)desc_count;
+    }
+
+    pthread_t *threads = calloc((size_t)thread_count, sizeof(pthread_t));
+    if (threads) {
+        for (int i = 0; i < thread_count; i++) {
+            pthread_create(&threads[i], NULL, verify_worker, &job);
+        }
+        for (int i = 0; i < thread_count; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+    } else {
+        verify_worker(&job);
+    }
+    pthread_mutex_destroy(&job.lock);
+
+    size_t mismatch_count = 0;
+    for (uint32_t i = 0; i < desc_count; i++) {
+        if (links[i].mismatch) {
+            if (mismatch_count == 0) {
+                char expected_hex[SHA1_DIGEST_SIZE * 2 + 1];
+                digest_to_hex(links[i].expected, expected_hex);
+                printf("First bad run: %u (offset 0x%zX, expected %s)\n",
+                       i, links[i].offset, expected_hex);
+            }
+            mismatch_count++;
+        }
+    }
+    printf("Verified:      %zu links\n",
+           (size_t)desc_count - fixup_count - mismatch_count);
+    if (fixup_count > 0) {
+        printf("Fixup runs:    %zu (import targets, skipped)\n", fixup_count);
+    }
+    printf("Result:        %s\n",
+           mismatch_count == 0 ? "VERIFIED" : "DIGEST MISMATCH");
+
+    free(links);
+    xex_view_close(&image);
+    xex_view_close(&xex_view);
+    xex_arena_release(&arena);
+    return mismatch_count == 0 ? 0 : 1;
+
+fail_xex:
+    xex_view_close(&xex_view);
+    xex_arena_release(&arena);
+    return 2;
+}
+
+/* Arena for the compressed-block index (entries scale with blocks) */
+#define BLOCK_INDEX_ARENA_SIZE (64 * 1024)
+
+/*
+ * Random access read: --read <offset>:<len> builds the block index and
+ * dumps exactly the requested uncompressed range to stdout, touching
+ * only the payload blocks that cover it.
+ */
+static int read_at_run(const char *filename, const char *range) {
+    uint32_t offset, len;
+    if (sscanf(range, "%u:%u", &offset, &len) != 2 || len == 0) {
+        fprintf(stderr, "ERROR: --read expects <offset>:<len>\n");
+        return 1;
+    }
+
+    XexView view;
+    XexArena arena;
+    XexParsed parsed;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    if (open_and_parse(filename, &view, &arena, &parsed) != XEX_OK) {
+        return 1;
+    }
+
+    uint8_t *index_buf = malloc(BLOCK_INDEX_ARENA_SIZE);
+    uint8_t *out = malloc(len);
+    int ret = 1;
+    if (index_buf && out) {
+        XexArena index_arena;
+        XexBlockIndex index;
+        xex_arena_init(&index_arena, index_buf, BLOCK_INDEX_ARENA_SIZE);
+
+        int status = xex_block_index_build(&view, &parsed, &index_arena,
+                                           &index);
+        if (status == XEX_OK) {
+            status = xex_read_at(&view, &parsed, &index, offset, out, len);
+        }
+        if (status == XEX_OK) {
+            fwrite(out, 1, len, stdout);
+            ret = 0;
+        } else if (status == XEX_ERR_UNSUPPORTED) {
+            fprintf(stderr, "ERROR: Random access needs an unencrypted "
+                            "NONE/BASIC image\n");
+        } else {
+            fprintf(stderr, "ERROR: Read failed: %s\n", xex_strerror(status));
+        }
+        xex_arena_release(&index_arena);
+    } else {
+        fprintf(stderr, "ERROR: Out of memory\n");
+    }
+
+    free(out);
+    free(index_buf);
+    xex_view_close(&view);
+    xex_arena_release(&arena);
+    return ret;
+}
+
+/* Apply a delta patch against a base image: --apply-delta */
+static int apply_delta(const char *patch_path, const char *base_path,
+                       const char *out_path) {
+    XexView patch_view;
+    XexArena arena;
+    XexParsed parsed;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    if (open_and_parse(patch_path, &patch_view, &arena, &parsed) != XEX_OK) {
+        return 1;
+    }
+
+    if (parsed.compression_type != XEX_COMPRESSION_DELTA) {
+        fprintf(stderr, "ERROR: '%s' is not a delta patch\n", patch_path);
+        xex_view_close(&patch_view);
+        return 1;
+    }
+
+    XexView base_view;
+    if (xex_view_open(base_path, &base_view, use_mmap) != XEX_OK) {
+        fprintf(stderr, "ERROR: Cannot open base image '%s'\n", base_path);
+        xex_view_close(&patch_view);
+        return 1;
+    }
+
+    int status = xex_apply_delta(&base_view, &patch_view, &parsed, out_path);
+    xex_view_close(&base_view);
+    xex_view_close(&patch_view);
+    xex_arena_release(&arena);
+
+    if (status != XEX_OK) {
+        if (status == XEX_ERR_UNSUPPORTED &&
+            parsed.encryption_type != XEX_ENCRYPTION_NONE) {
+            fprintf(stderr, "ERROR: Patch is encrypted - decryption required\n");
+        } else {
+            fprintf(stderr, "ERROR: Delta application failed: %s\n",
+                    xex_strerror(status));
+        }
+        return 1;
+    }
+
+    printf("Applied delta patch: %s\n", out_path);
+    return 0;
+}
+
+/*
+ * ---- Packed resource extraction ----
+ *
+ * --extract-resources decodes an XPR2 container - given directly, or
+ * located through the RESOURCE_INFO block of an unencrypted image -
+ * and writes every resource concurrently, one writer thread per
+ * output file reading straight from the mmap'd source.
+ */
+
+/* Arena for the XPR entry table (grows for oversized containers) */
+#define RESOURCE_ARENA_SIZE (16 * 1024)
+
+typedef struct {
+    const XexView *view;
+    const XprEntry *entry;
+    const char *out_dir;
+    int failed;
+} ResourceWriter;
+
+/* Writer task: one resource, one output file */
+static void *resource_writer(void *arg) {
+    ResourceWriter *job = arg;
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.%s", job->out_dir,
+             job->entry->name, job->entry->type);
+
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        job->failed = 1;
+        return NULL;
+    }
+    if (fwrite(job->view->data + job->entry->offset, 1, job->entry->size,
+               out) != job->entry->size) {
+        job->failed = 1;
+    }
+    /* Textures: the descriptor is followed by its texel data from the
+     * container's data block */
+    if (job->entry->data_size != 0 &&
+        fwrite(job->view->data + job->entry->data_offset, 1,
+               job->entry->data_size, out) != job->entry->data_size) {
+        job->failed = 1;
+    }
+    if (fclose(out) != 0) {
+        job->failed = 1;
+    }
+    return NULL;
+}
+
+/* Extract every entry of one XPR2 container into out_dir */
+static int extract_xpr(const XexView *view, const char *out_dir) {
+    XexArena arena;
+    XprContainer xpr;
+    uint8_t arena_buf[RESOURCE_ARENA_SIZE];
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    int status = xpr_parse(view, &arena, &xpr);
+    if (status != XEX_OK) {
+        fprintf(stderr, "ERROR: Cannot decode container: %s\n",
+                xex_strerror(status));
+        xex_arena_release(&arena);
+        return 1;
+    }
+
+    ResourceWriter *jobs = calloc(xpr.entry_count, sizeof(ResourceWriter));
+    pthread_t *threads = calloc(xpr.entry_count, sizeof(pthread_t));
+    if (!jobs || !threads) {
+        free(jobs);
+        free(threads);
+        xex_arena_release(&arena);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < xpr.entry_count; i++) {
+        jobs[i].view = view;
+        jobs[i].entry = &xpr.entries[i];
+        jobs[i].out_dir = out_dir;
+        if (pthread_create(&threads[i], NULL, resource_writer, &jobs[i]) != 0) {
+            /* Fall back to writing this one inline */
+            resource_writer(&jobs[i]);
+            threads[i] = pthread_self();
+        }
+    }
+
+    int failed = 0;
+    for (uint32_t i = 0; i < xpr.entry_count; i++) {
+        if (!pthread_equal(threads[i], pthread_self())) {
+            pthread_join(threads[i], NULL);
+        }
+        if (jobs[i].failed) {
+            fprintf(stderr, "ERROR: Cannot write resource '%s'\n",
+                    xpr.entries[i].name);
+            failed = 1;
+        } else {
+            printf("  %-24s %-4s %u bytes\n", xpr.entries[i].name,
+                   xpr.entries[i].type,
+                   xpr.entries[i].size + xpr.entries[i].data_size);
+        }
+    }
+    printf("Extracted %u resources to %s\n", xpr.entry_count, out_dir);
+
+    free(threads);
+    free(jobs);
+    xex_arena_release(&arena);
+    return failed;
+}
+
+/* Extract packed resources from an XPR container or a XEX image */
+static int extract_resources_run(const char *filename, const char *out_dir) {
+    if (mkdir(out_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR: Cannot create output directory '%s'\n",
+                out_dir);
+        return 1;
+    }
+
+    XexView view;
+    if (xex_view_open(filename, &view, use_mmap) != XEX_OK) {
+        fprintf(stderr, "ERROR: Cannot open file '%s'\n", filename);
+        return 1;
+    }
+
+    /* Bare XPR2 container: decode it directly */
+    uint32_t magic = 0;
+    if (view.size >= 4) {
+        memcpy(&magic, view.data, 4);
+        magic = be32_to_cpu(magic);
+    }
+    if (magic == XPR2_MAGIC) {
+        int ret = extract_xpr(&view, out_dir);
+        xex_view_close(&view);
+        return ret;
+    }
+
+    /* XEX image: locate the containers through RESOURCE_INFO */
+    XexArena arena;
+    XexParsed parsed;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+    int ret = 1;
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    int status = xex_parse(&view, &arena, &parsed);
+    if (status != XEX_OK) {
+        fprintf(stderr, "ERROR: '%s' is neither an XPR container nor a "
+                        "XEX image\n", filename);
+        goto fail;
+    }
+
+    const XexOptHeader *opt = xex_find_header(&parsed, XEX_HEADER_RESOURCE_INFO);
+    if (!opt) {
+        fprintf(stderr, "ERROR: Image has no RESOURCE_INFO header\n");
+        goto fail;
+    }
+    if (!parsed.has_file_format_info ||
+        parsed.encryption_type != XEX_ENCRYPTION_NONE ||
+        parsed.compression_type != XEX_COMPRESSION_NONE) {
+        fprintf(stderr, "ERROR: Resources of encrypted or compressed images "
+                        "are not reachable - extract the basefile first\n");
+        goto fail;
+    }
+
+    /* Block layout: total size, then {name[8], address, size} records.
+     * Addresses are virtual; the clear basefile maps the load address
+     * to pe_offset. */
+    size_t base = opt->value;
+    if (base + 4 > view.size) {
+        fprintf(stderr, "ERROR: RESOURCE_INFO block is truncated\n");
+        goto fail;
+    }
+    uint32_t block_size;
+    memcpy(&block_size, view.data + base, 4);
+    block_size = be32_to_cpu(block_size);
+    if (block_size < 4 || base + block_size > view.size) {
+        fprintf(stderr, "ERROR: RESOURCE_INFO block is truncated\n");
+        goto fail;
+    }
+
+    uint32_t load_address = xex_load_address(&view, &parsed);
+    uint32_t count = (block_size - 4) / 16;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *rec = view.data + base + 4 + (size_t)i * 16;
+        char name[9];
+        memcpy(name, rec, 8);
+        name[8] = '\0';
+        uint32_t address, size;
+        memcpy(&address, rec + 8, 4);
+        memcpy(&size, rec + 12, 4);
+        address = be32_to_cpu(address);
+        size = be32_to_cpu(size);
+
+        if (address < load_address) {
+            fprintf(stderr, "ERROR: Resource '%s' address is outside the "
+                            "image\n", name);
+            goto fail;
+        }
+        size_t offset = (size_t)parsed.pe_offset + (address - load_address);
+        if (offset + size > view.size) {
+            fprintf(stderr, "ERROR: Resource '%s' is truncated\n", name);
+            goto fail;
+        }
+
+        /* A resource is usually itself an XPR container; unpack it
+         * when it is, keep the raw bytes when it is not */
+        XexView sub;
+        sub.data = view.data + offset;
+        sub.size = size;
+        sub.is_mapped = 0;
+        uint32_t sub_magic = 0;
+        if (size >= 4) {
+            memcpy(&sub_magic, sub.data, 4);
+            sub_magic = be32_to_cpu(sub_magic);
+        }
+        if (sub_magic == XPR2_MAGIC) {
+            printf("%s: XPR container (%u bytes)\n", name, size);
+            if (extract_xpr(&sub, out_dir) != 0) {
+                goto fail;
+            }
+        } else {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s.bin", out_dir, name);
+            FILE *out = fopen(path, "wb");
+            if (!out || fwrite(sub.data, 1, size, out) != size) {
+                if (out) {
+                    fclose(out);
+                }
+                fprintf(stderr, "ERROR: Cannot write resource '%s'\n", name);
+                goto fail;
+            }
+            fclose(out);
+            printf("%s: raw resource (%u bytes)\n", name, size);
+        }
+    }
+    ret = 0;
+
+fail:
+    xex_view_close(&view);
+    xex_arena_release(&arena);
+    return ret;
+}
+
+/*
+ * Parallel content hashing for the store: the file is hashed in
+ * independent 1 MB chunks across worker threads and the ordered chunk
+ * digests are folded into one key.  The fold is a store-internal
+ * content address - deterministic and collision-resistant - not a
+ * format digest, so it is never compared against anything in a XEX.
+ */
+
+/* Chunk granularity for parallel content hashing */
+#define STORE_CHUNK_SIZE (1024 * 1024)
+
+/* Shared state for the chunk hash workers */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t chunk_count;
+    size_t next;                /* Next unclaimed chunk */
+    pthread_mutex_t lock;
+    uint8_t *digests;           /* chunk_count * SHA1_DIGEST_SIZE */
+} StoreHashJob;
+
+/* Worker thread: hash chunks until the job is drained */
+static void *store_hash_worker(void *arg) {
+    StoreHashJob *job = (StoreHashJob *)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        size_t index = job->next;
+        if (index >= job->chunk_count) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        size_t offset = index * (size_t)STORE_CHUNK_SIZE;
+        size_t len = job->size - offset;
+        if (len > STORE_CHUNK_SIZE) {
+            len = STORE_CHUNK_SIZE;
+        }
+        sha1(job->data + offset, len,
+             job->digests + index * SHA1_DIGEST_SIZE);
+    }
+
+    return NULL;
+}
+
+/* Hash a mapped view in parallel chunks into a single content key */
+static int hash_view_parallel(const XexView *view, int thread_count,
+                              uint8_t digest[SHA1_DIGEST_SIZE]) {
+    StoreHashJob job;
+    job.data = view->data;
+    job.size = view->size;
+    job.chunk_count = (view->size + STORE_CHUNK_SIZE - 1) / STORE_CHUNK_SIZE;
+    job.next = 0;
+    job.digests = malloc(job.chunk_count * SHA1_DIGEST_SIZE);
+    if (!job.digests) {
+        return 1;
+    }
+    pthread_mutex_init(&job.lock, NULL);
+
+    if (thread_count <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (ncpu > 0) ? (int)ncpu : 1;
+    }
+    if ((size_t)thread_count > job.chunk_count) {
+        thread_count = (int)job.chunk_count;
+    }
+
+    pthread_t *threads = calloc((size_t)thread_count, sizeof(pthread_t));
+    if (threads) {
+        for (int i = 0; i < thread_count; i++) {
+            pthread_create(&threads[i], NULL, store_hash_worker, &job);
+        }
+        for (int i = 0; i < thread_count; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+    } else {
+        store_hash_worker(&job);
+    }
+
+    /* Single-chunk files keep the plain SHA-1, larger files hash the
+     * ordered chunk digest list */
+    if (job.chunk_count == 1) {
+        memcpy(digest, job.digests, SHA1_DIGEST_SIZE);
+    } else {
+        sha1(job.digests, job.chunk_count * SHA1_DIGEST_SIZE, digest);
+    }
+
+    free(job.digests);
+    pthread_mutex_destroy(&job.lock);
+    return 0;
+}
+
+/*
+ * Content-addressed store finalization: hash the freshly extracted
+ * file (parallel engine), then either adopt it as a new store entry or
+ * discard it in favour of the existing identical one, and hard-link
+ * the entry to out_path.  Repeated extraction of duplicate content
+ * becomes a metadata operation instead of a fresh copy.
+ */
+static int store_finalize(const char *store_dir, const char *temp_path,
+                          const char *out_path, int thread_count) {
+    XexView image;
+    if (xex_view_open(temp_path, &image, use_mmap) != XEX_OK) {
+        unlink(temp_path);
+        return 1;
+    }
+
+    uint8_t digest[SHA1_DIGEST_SIZE];
+    int failed = (hash_view_parallel(&image, thread_count, digest) != 0);
+    xex_view_close(&image);
+    if (failed) {
+        unlink(temp_path);
+        return 1;
+    }
+
+    char hex[SHA1_DIGEST_SIZE * 2 + 1];
+    digest_to_hex(digest, hex);
+
+    char entry_path[4096];
+    snprintf(entry_path, sizeof(entry_path), "%s/%s.bin", store_dir, hex);
+
+    struct stat st;
+    if (stat(entry_path, &st) == 0) {
+        /* Duplicate content: the store already has these bytes */
+        unlink(temp_path);
+    } else if (rename(temp_path, entry_path) != 0) {
+        unlink(temp_path);
+        return 1;
+    }
+
+    unlink(out_path);
+    if (link(entry_path, out_path) != 0) {
+        fprintf(stderr, "ERROR: Cannot link store entry to '%s'\n", out_path);
+        return 1;
+    }
+    return 0;
+}
+
+/* Extract the PE basefile from a XEX image to out_path */
+static int extract_basefile(const char *filename, const char *out_path,
+                            const char *store_dir, int thread_count) {
+    XexView view;
+    XexArena arena;
+    XexParsed parsed;
+    uint8_t arena_buf[PARSE_ARENA_SIZE];
+
+    xex_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    if (open_and_parse(filename, &view, &arena, &parsed) != XEX_OK) {
+        return 1;
+    }
+
+    /* With a store, extract into the store directory first so the
+     * final publish is a rename plus a hard link */
+    char temp_path[4096];
+    const char *target = out_path;
+    if (store_dir) {
+        snprintf(temp_path, sizeof(temp_path), "%s/.extract.%d.tmp",
+                 store_dir, (int)getpid());
+        target = temp_path;
+    }
+
+    /* Stored basefiles take the zero-copy kernel path; everything else
+     * goes through the decrypt/decompress pipeline */
+    uint64_t t_extract = stats_now();
+    int status = xex_extract_basefile_zerocopy(filename, &parsed, target);
+    if (status == XEX_ERR_UNSUPPORTED) {
+        status = xex_extract_basefile(&view, &parsed, target);
+    }
+    stats_add(&stats.extract_ns, t_extract);
+    xex_view_close(&view);
+    xex_arena_release(&arena);
+
+    if (status != XEX_OK) {
+        if (status == XEX_ERR_UNSUPPORTED &&
+            parsed.encryption_type != XEX_ENCRYPTION_NONE) {
+            fprintf(stderr, "ERROR: Image is encrypted - decryption required\n");
+        } else {
+            fprintf(stderr, "ERROR: Extraction failed: %s\n", xex_strerror(status));
+        }
+        return 1;
+    }
+
+    if (store_dir &&
+        store_finalize(store_dir, temp_path, out_path, thread_count) != 0) {
+        fprintf(stderr, "ERROR: Cannot publish '%s' to the store\n", out_path);
+        return 1;
+    }
+
+    printf("Extracted basefile: %s\n", out_path);
+    return 0;
+}
+
+/*
+ * ---- Linker map symbol index ----
+ *
+ * --index-map compiles a plain-text linker .map into a binary sidecar
+ * (<map>.idx) holding a sorted address->symbol table, and --symbol
+ * answers "what function owns this address" with an mmap plus one
+ * binary search instead of re-parsing the whole map per query.
+ */
+
+/* Compile map_path into <map_path>.idx */
+static int index_map_run(const char *map_path) {
+    char idx_path[4096];
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", map_path);
+
+    if (mapindex_build(map_path, idx_path) != 0) {
+        fprintf(stderr, "ERROR: Cannot index map file '%s'\n", map_path);
+        return 1;
+    }
+    printf("Indexed map: %s\n", idx_path);
+    return 0;
+}
+
+/* Look up an address in a sidecar built by --index-map */
+static int symbol_lookup_run(const char *idx_path, const char *addr_str) {
+    uint32_t address = (uint32_t)strtoul(addr_str, NULL, 16);
+    char name[512];
+    uint32_t symbol_address;
+
+    if (mapindex_lookup(idx_path, address, name, sizeof(name),
+                        &symbol_address) != 0) {
+        fprintf(stderr, "ERROR: No symbol for 0x%08X in '%s'\n",
+                address, idx_path);
+        return 1;
+    }
+    printf("0x%08X: %s+0x%X\n", address, name, address - symbol_address);
+    return 0;
+}
+
+/* Display help message */
+void print_usage(const char *prog_name) {
+    fprintf(stderr, "Usage: %s [OPTIONS] <xex-file>\n", prog_name);
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -v, --verbose      Enable verbose output (shows all optional headers)\n");
+    fprintf(stderr, "  -e, --encryption   Display detailed encryption information\n");
+    fprintf(stderr, "      --no-mmap      Disable mmap and read the file instead\n");
+    fprintf(stderr, "      --stream       Parse a pipe or stdin (\"-\") in one\n");
+    fprintf(stderr, "                     forward pass, with no seeking\n");
+    fprintf(stderr, "      --json         Emit one NDJSON record per file\n");
+    fprintf(stderr, "      --scan <dir>   Scan a directory tree for XEX files\n");
+    fprintf(stderr, "      --incremental <manifest>  With --scan: re-analyze only\n");
+    fprintf(stderr, "                     files that changed since the last run\n");
+    fprintf(stderr, "      --extract-basefile <out>  Extract the PE basefile\n");
+    fprintf(stderr, "      --extract-resources <dir>  Unpack XPR2 resources\n");
+    fprintf(stderr, "                     (from a container or a clear image)\n");
+    fprintf(stderr, "      --read <off>:<len>  Dump an uncompressed byte range to stdout\n");
+    fprintf(stderr, "      --apply-delta      Apply a delta patch (needs --base and -o)\n");
+    fprintf(stderr, "      --base <xex>   Base image for --apply-delta\n");
+    fprintf(stderr, "  -o, --output <file>  Output path for --apply-delta\n");
+    fprintf(stderr, "      --cache <dir>  Cache analysis results keyed by file identity\n");
+    fprintf(stderr, "      --store <dir>  Content-addressed store for extracted basefiles\n");
+    fprintf(stderr, "                     (duplicate content becomes a hard link)\n");
+    fprintf(stderr, "      --stats        Emit per-stage timing counters as JSON on stderr\n");
+    fprintf(stderr, "      --check <encryption|compression|security>  Silent check\n");
+    fprintf(stderr, "                     via exit code (0 = yes/accept, 1 = no/reject,\n");
+    fprintf(stderr, "                     2 = error); security gates on the security\n");
+    fprintf(stderr, "                     info block validation\n");
+    fprintf(stderr, "      --daemon <sock>    Serve analysis requests over a Unix socket\n");
+    fprintf(stderr, "      --verify <image>   Check a decrypted image against the\n");
+    fprintf(stderr, "                     security info block (0 = ok, 1 = mismatch)\n");
+    fprintf(stderr, "      --index-map <map>  Compile a linker .map into <map>.idx\n");
+    fprintf(stderr, "      --symbol <addr>    Look up a hex address in a .idx file\n");
+    fprintf(stderr, "  -j, --threads <n>  Worker threads for --scan (default: all cores)\n");
+    fprintf(stderr, "  -h, --help         Show this help message\n");
+    fprintf(stderr, "\nExamples:\n");
+    fprintf(stderr, "  %s dolphin.xex\n", prog_name);
+    fprintf(stderr, "  %s --verbose dolphin.xex\n", prog_name);
+    fprintf(stderr, "  %s --encryption dolphin.xex\n", prog_name);
+    fprintf(stderr, "  %s -v -e dolphin.xex\n", prog_name);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    const char *xex_file = NULL;
+    const char *scan_dir = NULL;
+    const char *incremental_manifest = NULL;
+    const char *extract_path = NULL;
+    const char *check_what = NULL;
+    const char *index_map_path = NULL;
+    const char *symbol_addr = NULL;
+    const char *verify_path = NULL;
+    const char *daemon_socket = NULL;
+    int apply_delta_mode = 0;
+    const char *base_path = NULL;
+    const char *output_path = NULL;
+    const char *store_dir = NULL;
+    const char *read_range = NULL;
+    const char *resource_dir = NULL;
+    int stream_mode = 0;
+    int thread_count = 0;    /* 0 = one worker per online core */
+
+    /* Define long options */
+    static struct option long_options[] = {
+        {"verbose",    no_argument,       0, 'v'},
+        {"encryption", no_argument,       0, 'e'},
+        {"no-mmap",    no_argument,       0, 'M'},
+        {"stream",     no_argument,       0, 'm'},
+        {"json",       no_argument,       0, 'J'},
+        {"scan",       required_argument, 0, 's'},
+        {"incremental", required_argument, 0, 'i'},
+        {"extract-basefile", required_argument, 0, 'x'},
+        {"extract-resources", required_argument, 0, 'X'},
+        {"read",       required_argument, 0, 'R'},
+        {"apply-delta", no_argument,      0, 'A'},
+        {"base",       required_argument, 0, 'B'},
+        {"output",     required_argument, 0, 'o'},
+        {"cache",      required_argument, 0, 'C'},
+        {"store",      required_argument, 0, 'T'},
+        {"stats",      no_argument,       0, 'P'},
+        {"check",      required_argument, 0, 'c'},
+        {"daemon",     required_argument, 0, 'D'},
+        {"verify",     required_argument, 0, 'V'},
+        {"index-map",  required_argument, 0, 'I'},
+        {"symbol",     required_argument, 0, 'S'},
+        {"threads",    required_argument, 0, 'j'},
+        {"help",       no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Parse command-line options */
+    while ((opt = getopt_long(argc, argv, "vej:o:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'v':
+                verbose_mode = 1;
+                break;
+            case 'e':
+                show_encryption = 1;
+                break;
+            case 'M':
+                use_mmap = 0;
+                break;
+            case 'm':
+                stream_mode = 1;
+                break;
+            case 'J':
+                json_mode = 1;
+                break;
+            case 's':
+                scan_dir = optarg;
+                break;
+            case 'i':
+                incremental_manifest = optarg;
+                break;
+            case 'x':
+                extract_path = optarg;
+                break;
+            case 'X':
+                resource_dir = optarg;
+                break;
+            case 'R':
+                read_range = optarg;
+                break;
+            case 'A':
+                apply_delta_mode = 1;
+                break;
+            case 'B':
+                base_path = optarg;
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            case 'C':
+                cache_dir = optarg;
+                break;
+            case 'T':
+                store_dir = optarg;
+                break;
+            case 'P':
+                stats_mode = 1;
+                break;
+            case 'c':
+                check_what = optarg;
+                break;
+            case 'D':
+                daemon_socket = optarg;
+                break;
+            case 'V':
+                verify_path = optarg;
+                break;
+            case 'I':
+                index_map_path = optarg;
+                break;
+            case 'S':
+                symbol_addr = optarg;
+                break;
+            case 'j':
+                thread_count = atoi(optarg);
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    /* Create the cache directory on first use */
+    if (cache_dir && mkdir(cache_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR: Cannot create cache directory '%s'\n", cache_dir);
+        return 1;
+    }
+
+    /* Same for the content-addressed store */
+    if (store_dir && mkdir(store_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR: Cannot create store directory '%s'\n", store_dir);
+        return 1;
+    }
+
+    /* Daemon mode: serve requests until killed */
+    if (daemon_socket) {
+        return daemon_run(daemon_socket);
+    }
+
+    /* Batch mode: scan a directory tree instead of a single file */
+    if (scan_dir) {
+        int ret = incremental_manifest
+                      ? scan_incremental(scan_dir, incremental_manifest,
+                                         thread_count)
+                      : scan_directory(scan_dir, thread_count);
+        if (stats_mode) {
+            stats_emit();
+        }
+        return ret;
+    }
+    if (incremental_manifest) {
+        fprintf(stderr, "ERROR: --incremental requires --scan\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    /* Map index build needs no XEX file */
+    if (index_map_path) {
+        return index_map_run(index_map_path);
+    }
+
+    /* Check if XEX file is provided */
+    if (optind >= argc) {
+        fprintf(stderr, "ERROR: No %s specified\n\n",
+                symbol_addr ? "index file" : "XEX file");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    xex_file = argv[optind];
+
+    /* Symbol lookup takes the .idx file as its positional argument */
+    if (symbol_addr) {
+        return symbol_lookup_run(xex_file, symbol_addr);
+    }
+
+    if (stream_mode) {
+        return analyze_xex_stream(xex_file);
+    }
+    if (check_what) {
+        return check_mode_run(xex_file, check_what);
+    }
+    if (verify_path) {
+        return verify_image(xex_file, verify_path, thread_count);
+    }
+    if (read_range) {
+        return read_at_run(xex_file, read_range);
+    }
+    if (resource_dir) {
+        return extract_resources_run(xex_file, resource_dir);
+    }
+    if (apply_delta_mode) {
+        if (!base_path || !output_path) {
+            fprintf(stderr, "ERROR: --apply-delta needs --base and --output\n\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+        return apply_delta(xex_file, base_path, output_path);
+    }
+    int ret;
+    if (extract_path) {
+        ret = extract_basefile(xex_file, extract_path, store_dir,
+                               thread_count);
+    } else if (json_mode) {
+        ret = analyze_xex_json(xex_file);
+    } else {
+        ret = analyze_xex_file(xex_file);
+    }
+    if (stats_mode) {
+        stats_emit();
+    }
+    return ret;
 }
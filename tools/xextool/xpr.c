@@ -0,0 +1,146 @@
+/*
+ * xpr - Xbox packed resource (XPR2) container parsing
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xpr.h"
+
+/* Raw 16-byte table entry (big-endian on disk) */
+typedef struct {
+    uint32_t type;
+    uint32_t offset;           /* Relative to the header data at +12 */
+    uint32_t size;
+    uint32_t name_offset;      /* Relative to the header data at +12 */
+} __attribute__((packed)) XprRawEntry;
+
+/* Offset of the header data all table offsets are relative to */
+#define XPR_HEADER_DATA 12
+
+/* TX2D entries point at a 52-byte D3D texture descriptor; the texel
+ * bytes live in the data block after the header, located by the GPU
+ * texture fetch constant inside the descriptor.  The upper 20 bits of
+ * the constant's first address dword (descriptor dword 8) hold the
+ * base address in 4 KiB pages, relative to the start of the data
+ * block. */
+#define XPR_TEXTURE_DESC_SIZE 52
+#define XPR_TEXTURE_PAGE 4096
+
+/* Decode the entry table out of a container view */
+int xpr_parse(const XexView *view, XexArena *arena, XprContainer *out) {
+    memset(out, 0, sizeof(*out));
+
+    if (view->size < XPR_HEADER_DATA + 4) {
+        return XEX_ERR_TRUNCATED;
+    }
+
+    uint32_t magic, header_size, data_size, count;
+    memcpy(&magic, view->data, 4);
+    memcpy(&header_size, view->data + 4, 4);
+    memcpy(&data_size, view->data + 8, 4);
+    memcpy(&count, view->data + XPR_HEADER_DATA, 4);
+    magic = be32_to_cpu(magic);
+    header_size = be32_to_cpu(header_size);
+    data_size = be32_to_cpu(data_size);
+    count = be32_to_cpu(count);
+
+    if (magic != XPR2_MAGIC) {
+        return XEX_ERR_MAGIC;
+    }
+    if (header_size > view->size ||
+        (size_t)XPR_HEADER_DATA + header_size + data_size > view->size) {
+        return XEX_ERR_TRUNCATED;
+    }
+
+    size_t table_end = XPR_HEADER_DATA + 4 + (size_t)count * sizeof(XprRawEntry);
+    if (count == 0 || table_end > header_size) {
+        return XEX_ERR_FORMAT;
+    }
+
+    XprEntry *entries = xex_arena_alloc(arena, count * sizeof(XprEntry));
+    if (!entries) {
+        return XEX_ERR_NOMEM;
+    }
+
+    const XprRawEntry *raw =
+        (const XprRawEntry *)(view->data + XPR_HEADER_DATA + 4);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t type = be32_to_cpu(raw[i].type);
+        uint32_t offset = be32_to_cpu(raw[i].offset);
+        uint32_t size = be32_to_cpu(raw[i].size);
+        uint32_t name_offset = be32_to_cpu(raw[i].name_offset);
+
+        /* The resource bytes must lie inside the container */
+        if ((size_t)XPR_HEADER_DATA + offset + size > view->size) {
+            return XEX_ERR_FORMAT;
+        }
+        entries[i].offset = XPR_HEADER_DATA + offset;
+        entries[i].size = size;
+        entries[i].data_offset = 0;
+        entries[i].data_size = 0;
+
+        /* FourCC, stored big-endian so the bytes read naturally */
+        entries[i].type[0] = (char)(type >> 24);
+        entries[i].type[1] = (char)(type >> 16);
+        entries[i].type[2] = (char)(type >> 8);
+        entries[i].type[3] = (char)type;
+        entries[i].type[4] = '\0';
+
+        /* Copy the name out of the string table, bounds-checked */
+        size_t name_at = (size_t)XPR_HEADER_DATA + name_offset;
+        size_t n = 0;
+        while (name_at + n < header_size && n < XPR_NAME_MAX - 1 &&
+               view->data[name_at + n] != '\0') {
+            entries[i].name[n] = (char)view->data[name_at + n];
+            n++;
+        }
+        entries[i].name[n] = '\0';
+        if (n == 0) {
+            return XEX_ERR_FORMAT;
+        }
+    }
+
+    /* Resolve the texel data range of each texture.  The descriptor
+     * records no byte length, but the bundler packs textures and their
+     * mip chains back to back in ascending address order, so each one
+     * runs to the next texture's base address - the last to the end of
+     * the data block. */
+    uint32_t data_end = XPR_HEADER_DATA + header_size + data_size;
+    for (uint32_t i = 0; i < count; i++) {
+        if (memcmp(entries[i].type, "TX2D", 4) != 0 ||
+            entries[i].size < XPR_TEXTURE_DESC_SIZE) {
+            continue;
+        }
+        uint32_t fetch;
+        memcpy(&fetch, view->data + entries[i].offset + 32, 4);
+        fetch = be32_to_cpu(fetch);
+        uint32_t start = (fetch >> 12) * XPR_TEXTURE_PAGE;
+        if (start >= data_size) {
+            return XEX_ERR_FORMAT;
+        }
+        entries[i].data_offset = XPR_HEADER_DATA + header_size + start;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (entries[i].data_offset == 0) {
+            continue;
+        }
+        uint32_t end = data_end;
+        for (uint32_t j = 0; j < count; j++) {
+            if (entries[j].data_offset > entries[i].data_offset &&
+                entries[j].data_offset < end) {
+                end = entries[j].data_offset;
+            }
+        }
+        entries[i].data_size = end - entries[i].data_offset;
+    }
+
+    out->header_size = header_size;
+    out->data_size = data_size;
+    out->entry_count = count;
+    out->entries = entries;
+    return XEX_OK;
+}
@@ -0,0 +1,55 @@
+/*
+ * xpr - Xbox packed resource (XPR2) container parsing
+ *
+ * XPR2 containers (Resource.xpr, bundled font textures) hold a header
+ * block and a bulk data block.  The header starts with a 12-byte
+ * prefix {magic, header_size, data_size}; everything after it is
+ * "header data" beginning with the resource count and the entry table,
+ * and all table offsets are relative to the start of that header data.
+ *
+ * Parsing only decodes the table - the caller decides what to do with
+ * each entry's bytes.  Statuses are the XEX_ERR_* codes from xex.h.
+ */
+
+#ifndef XPR_H
+#define XPR_H
+
+#include <stdint.h>
+
+#include "xex.h"
+
+#define XPR2_MAGIC 0x58505232           /* "XPR2" in big-endian */
+
+/* Longest resource name retained (the bundler emits short names) */
+#define XPR_NAME_MAX 64
+
+/* One decoded resource entry, offsets converted to absolute file
+ * offsets into the container.  For TX2D entries offset/size cover only
+ * the texture descriptor in the header block; data_offset/data_size
+ * locate the texel bytes in the data block (0/0 when the entry has no
+ * data-block payload). */
+typedef struct {
+    char name[XPR_NAME_MAX];
+    char type[5];              /* FourCC, e.g. "TX2D", "USER" */
+    uint32_t offset;           /* File offset of the resource bytes */
+    uint32_t size;
+    uint32_t data_offset;      /* File offset of the texel data, or 0 */
+    uint32_t data_size;
+} XprEntry;
+
+/* Parsed container; the entry table is arena-allocated */
+typedef struct {
+    uint32_t header_size;      /* File offset where the data block starts */
+    uint32_t data_size;
+    uint32_t entry_count;
+    const XprEntry *entries;
+} XprContainer;
+
+/*
+ * Decode the entry table out of a container view.  Returns XEX_OK,
+ * XEX_ERR_MAGIC when the view is not an XPR2 container, or another
+ * XEX_ERR_* status.
+ */
+int xpr_parse(const XexView *view, XexArena *arena, XprContainer *out);
+
+#endif /* XPR_H */